@@ -1,31 +1,144 @@
+#include "beamgenerator.h"
+#include "beammodel.h"
 #include "fitsreader.h"
 #include "fitswriter.h"
 #include "image.h"
+#include "parallelfor.h"
+#include "tools.h"
 
 #include "units/angle.h"
-#include "units/imagecoordinates.h"
 #include "units/radeccoord.h"
-#include "units/ncpprojection.h"
 
-#include <cmath>
 #include <iostream>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
+#include <string>
 
 #include <boost/optional.hpp>
 
-int main(int argc, char* argv[])
+namespace {
+	/**
+	 * Generators of earlier runs, see SetApBeamCacheSize(), with the most
+	 * recently used first. A generator is taken out of the cache while it is
+	 * used, so that concurrent runs never share one.
+	 */
+	struct CachedGenerator
+	{
+		std::string key;
+		std::unique_ptr<BeamGenerator> generator;
+	};
+	std::mutex cacheMutex;
+	size_t cacheSize = 0;
+	std::list<CachedGenerator> cache;
+	std::string defaultCacheDirectory;
+	
+	/**
+	 * The values that the distances of a generator depend on. Other settings,
+	 * like the model, are set on every run.
+	 */
+	std::string generatorKey(const FitsReader& reader, size_t coarseStep, const std::string& cacheDirectory)
+	{
+		std::ostringstream key;
+		key.precision(std::numeric_limits<double>::max_digits10);
+		key << reader.ImageWidth() << ' ' << reader.ImageHeight() << ' ' <<
+			reader.PixelSizeX() << ' ' << reader.PixelSizeY() << ' ' <<
+			int(reader.ProjectionType()) << ' ' << reader.PhaseCentreDec() << ' ' <<
+			reader.PhaseCentreDL() << ' ' << reader.PhaseCentreDM() << ' ' <<
+			coarseStep << ' ' << cacheDirectory;
+		return key.str();
+	}
+	
+	std::unique_ptr<BeamGenerator> takeGenerator(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		for(std::list<CachedGenerator>::iterator i=cache.begin(); i!=cache.end(); ++i)
+		{
+			if(i->key == key)
+			{
+				std::unique_ptr<BeamGenerator> generator = std::move(i->generator);
+				cache.erase(i);
+				return generator;
+			}
+		}
+		return std::unique_ptr<BeamGenerator>();
+	}
+	
+	void returnGenerator(const std::string& key, std::unique_ptr<BeamGenerator> generator)
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		if(cacheSize != 0)
+		{
+			cache.emplace_front(CachedGenerator{key, std::move(generator)});
+			while(cache.size() > cacheSize)
+				cache.pop_back();
+		}
+	}
+}
+
+void SetApBeamCacheSize(size_t size)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	cacheSize = size;
+	while(cache.size() > cacheSize)
+		cache.pop_back();
+}
+
+void SetApBeamDefaultDistanceCache(const std::string& directory)
+{
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	defaultCacheDirectory = directory;
+}
+
+int RunApBeam(int argc, char* argv[])
 {
 	if(argc < 4)
 	{
 		std::cout <<
 			"\tSyntax: apbeam [options] <input> <outbeam> <outweight>\n"
-			"This tool creates an output file with a simple Westerbork beam for the given input beam.\n"
+			"This tool creates an output file with a primary beam for the given input image. By default,\n"
+			"this is a simple Westerbork beam.\n"
 			"options:\n"
-			"\t-frequency <value in MHz>\n";
+			"\t-model <wsrt / gaussian / airy / polynomial>\n"
+			"\t\tBeam model. Gaussian and airy are the beams of a dish with the given diameter, polynomial\n"
+			"\t\tis the AIPS PBCOR model with coefficients G1, G2, ... (default: VLA).\n"
+			"\t-dish-diameter <meters>\n"
+			"\t\tDish diameter for the gaussian and airy models. Default: 25.\n"
+			"\t-coefficients <G1,G2,...>\n"
+			"\t\tCoefficients for the polynomial model.\n"
+			"\t-frequency <value in MHz>\n"
+			"\t\tFrequency of the (first) channel. Default: from the input image.\n"
+			"\t-channels <n>\n"
+			"\t\tWrite a beam cube with n channels. Default: the number of channels in the input image.\n"
+			"\t-channel-width <value in MHz>\n"
+			"\t\tFrequency step between channels. Default: from the input image.\n"
+			"\t-threads <n>\n"
+			"\t\tNumber of threads to use for calculating the beam. Default: number of cores.\n"
+			"\t-lut-tolerance <value>\n"
+			"\t\tEvaluate the beam by interpolating a radial lookup table, with the given maximum\n"
+			"\t\tabsolute error (e.g. 1e-7). By default, the beam is evaluated exactly for every pixel.\n"
+			"\t-coarse-step <n>\n"
+			"\t\tEvaluate the beam only every n pixels, and use bicubic interpolation in between.\n"
+			"\t-coarse-tolerance <value>\n"
+			"\t\tMaximum interpolation error for -coarse-step. Cells with a larger error are evaluated\n"
+			"\t\texactly. Default: 1e-6.\n"
+			"\t-distance-cache <directory>\n"
+			"\t\tStore the map of distances to the phase centre in the given directory, and reuse\n"
+			"\t\tit in later runs on images with the same geometry. The map is stored in single precision.\n";
 		return 0;
 	}
 	
-	boost::optional<double> frequency;
+	boost::optional<double> frequency, channelWidth;
+	boost::optional<size_t> nChannels;
+	size_t nThreads = ParallelFor::HardwareThreads();
+	double lutTolerance = 0.0;
+	size_t coarseStep = 0;
+	double coarseTolerance = 1e-6;
+	std::string cacheDirectory;
+	BeamModel model;
 	
 	int argi = 1;
 	while(argi < argc && argv[argi][0] == '-')
@@ -36,65 +149,148 @@ int main(int argc, char* argv[])
 			++argi;
 			frequency = atoi(argv[argi])*1e6;
 		}
+		else if(p == "model")
+		{
+			++argi;
+			model.SetType(BeamModel::ParseType(argv[argi]));
+		}
+		else if(p == "dish-diameter")
+		{
+			++argi;
+			model.SetDishDiameter(atof(argv[argi]));
+		}
+		else if(p == "coefficients")
+		{
+			++argi;
+			model.SetCoefficients(BeamModel::ParseCoefficients(argv[argi]));
+		}
+		else if(p == "channels")
+		{
+			++argi;
+			nChannels = size_t(atoi(argv[argi]));
+		}
+		else if(p == "channel-width")
+		{
+			++argi;
+			channelWidth = atof(argv[argi])*1e6;
+		}
+		else if(p == "threads")
+		{
+			++argi;
+			nThreads = atoi(argv[argi]);
+		}
+		else if(p == "lut-tolerance")
+		{
+			++argi;
+			lutTolerance = atof(argv[argi]);
+		}
+		else if(p == "coarse-step")
+		{
+			++argi;
+			coarseStep = atoi(argv[argi]);
+		}
+		else if(p == "coarse-tolerance")
+		{
+			++argi;
+			coarseTolerance = atof(argv[argi]);
+		}
+		else if(p == "distance-cache")
+		{
+			++argi;
+			cacheDirectory = argv[argi];
+		}
 		else throw std::runtime_error("Bad parameter");
 		++argi;
 	}
+	if(cacheDirectory.empty())
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		cacheDirectory = defaultCacheDirectory;
+	}
 	
 	const char* inpFilename = argv[argi];
 	const char* outBeamFilename = argv[argi+1];
 	const char* outWeightFilename = argv[argi+2];
 	
-	FitsReader reader(inpFilename);
+	FitsReader reader(inpFilename, true, true);
 	size_t width = reader.ImageWidth(), height = reader.ImageHeight();
-	Image beam(width, height), weight(width, height);
 
-	// pb = cos**6(beta*freq(MHz)*angle(degrees))
-	// where beta = 0.0629 for f < 500 MHz, and 0.065 for f > 500 MHz
+	if(!nChannels)
+		nChannels = reader.NFrequencies();
+	if(!channelWidth)
+		channelWidth = reader.Bandwidth();
+	// The first channel is at pixel 1 of the frequency axis, which need not be its reference pixel
 	if(!frequency)
-		frequency = reader.Frequency();
-	double freqMHz = frequency.get()*1e-6;
-	double beta;
-	if(freqMHz < 500)
-		beta = 0.0629;
-	else
-		beta = 0.065;
+		frequency = reader.PlaneFrequency(0);
+	if(nChannels.get() == 0)
+		throw std::runtime_error("Number of channels should be at least one");
 	if(reader.ProjectionType() == FitsReader::NCPProjection)
 		std::cout << "Image is in deprecated NCP projection.\n";
 	std::cout <<
-		"Making beam with freq=" << freqMHz << " MHz\n"
+		"Making " << BeamModel::TypeName(model.GetType()) << " beam with freq=" << frequency.get()*1e-6 << " MHz";
+	if(nChannels.get() != 1)
+		std::cout << ", " << nChannels.get() << " channels of " << channelWidth.get()*1e-6 << " MHz";
+	std::cout << "\n"
 		"Pixelscale: " << Angle::ToNiceString(reader.PixelSizeX()) << " x " << Angle::ToNiceString(reader.PixelSizeY()) << '\n' <<
 		"Phase centre: " << RaDecCoord::RaDecToString(reader.PhaseCentreRA(), reader.PhaseCentreDec()) << '\n';
 	
-	// In the equation, angle should be in degrees, but we calculate it in rad so absorp the conversion in beta:
-	//beta *= 180.0/M_PI; // it's also cos in degrees so not necessary
-
-	double* pbPtr = beam.data();
-	double* wPtr = weight.data();
-	for(size_t y=0; y!=height; ++y)
+	const std::string key = generatorKey(reader, coarseStep, cacheDirectory);
+	std::unique_ptr<BeamGenerator> generator = takeGenerator(key);
+	if(generator)
+		std::cout << "Reusing the distances of an earlier run with the same geometry.\n";
+	else {
+		generator.reset(new BeamGenerator(reader));
+		if(!cacheDirectory.empty())
+			generator->SetDistanceCache(cacheDirectory);
+	}
+	generator->SetModel(model);
+	generator->SetNThreads(nThreads);
+	generator->SetLookupTolerance(lutTolerance);
+	generator->SetCoarseGrid(coarseStep, coarseTolerance);
+	generator->SetLog(&std::cout);
+	std::cout << "Max angle: " << Angle::ToNiceString(generator->MaxAngle()) << '\n';
+	
+	// The written frequency axis has its reference at the first channel
+	FitsWriter beamWriter(reader), weightWriter(reader);
+	beamWriter.SetFrequency(frequency.get(), channelWidth.get());
+	weightWriter.SetFrequency(frequency.get(), channelWidth.get());
+	if(nChannels.get() != 1)
 	{
-		for(size_t x=0; x!=width; ++x)
+		for(FitsWriter* writer : { &beamWriter, &weightWriter })
 		{
-			double l, m, ra, dec;
-			ImageCoordinates::XYToLM(x, y, reader.PixelSizeX(), reader.PixelSizeY(), width, height, l, m);
-			if(reader.ProjectionType() == FitsReader::SINProjection)
-			{
-				ImageCoordinates::LMToRaDec(l, m, reader.PhaseCentreRA(), reader.PhaseCentreDec(), ra, dec);
-			}
-			else {
-				NCPProjection::LMToRaDec(l, m, reader.PhaseCentreRA(), reader.PhaseCentreDec(), ra, dec);
-			}
-			double angle = ImageCoordinates::AngularDistance(ra, dec, reader.PhaseCentreRA(), reader.PhaseCentreDec());
-			if(x==0 && y==0)
-				std::cout << "Max angle: " << Angle::ToNiceString(angle) << '\n';
-			
-			double cosTerm = cos(beta*freqMHz*angle);
-			*pbPtr = cosTerm*cosTerm*cosTerm*cosTerm*cosTerm*cosTerm;
-			*wPtr = (*pbPtr) * (*pbPtr);
-			++pbPtr;
-			++wPtr;
+			writer->AddExtraDimension(FitsWriter::FrequencyDimension, nChannels.get());
+			writer->AddExtraDimension(FitsWriter::PolarizationDimension, 1);
+		}
+		beamWriter.StartMulti(outBeamFilename);
+		weightWriter.StartMulti(outWeightFilename);
+	}
+	
+	// The output is stored in single precision, like the FITS files are. The beam
+	// is calculated in double precision and only rounded when a row is stored, so
+	// that the written values are the same as when storing double-precision planes.
+	ImageF beam(width, height), weight(width, height);
+	for(size_t channel=0; channel!=nChannels.get(); ++channel)
+	{
+		const double channelFrequency = frequency.get() + channel*channelWidth.get();
+		generator->Generate(channelFrequency, beam.data(), weight.data());
+		
+		if(nChannels.get() == 1)
+		{
+			beamWriter.Write(outBeamFilename, beam.data());
+			weightWriter.Write(outWeightFilename, weight.data());
+		}
+		else {
+			beamWriter.AddToMulti(beam.data());
+			weightWriter.AddToMulti(weight.data());
 		}
 	}
-	FitsWriter writer(reader);
-	writer.Write(outBeamFilename, beam.data());
-	writer.Write(outWeightFilename, weight.data());
+	
+	if(nChannels.get() != 1)
+	{
+		beamWriter.FinishMulti();
+		weightWriter.FinishMulti();
+	}
+	
+	returnGenerator(key, std::move(generator));
+	return 0;
 }
@@ -0,0 +1,101 @@
+#include "daemonprotocol.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/**
+ * Client for apertoolsd. It has the same command line as the tools, and is
+ * meant to be installed under their names (e.g. as a symbolic link called
+ * applybeam earlier in the PATH); the tool is selected from the name it is
+ * called with. Called as apclient, the first argument is the tool name.
+ */
+int main(int argc, char* argv[])
+{
+	std::string name(argv[0]);
+	const size_t slash = name.rfind('/');
+	if(slash != std::string::npos)
+		name = name.substr(slash + 1);
+	std::vector<std::string> arguments;
+	if(name == "apbeam" || name == "applybeam" || name == "apindex")
+	{
+		arguments.assign(argv, argv + argc);
+		arguments.front() = name;
+	}
+	else if(argc < 2)
+	{
+		std::cout <<
+			"Syntax: apclient <apbeam / applybeam / apindex> [tool arguments]\n"
+			"Runs a tool in apertoolsd. When apclient is installed (e.g. as a symbolic link)\n"
+			"under the name of one of the tools, it runs that tool, with the same command line.\n"
+			"The daemon socket is $APERTOOLSD_SOCKET, or apertoolsd.socket in $XDG_RUNTIME_DIR,\n"
+			"or /tmp/apertoolsd-<uid>.socket.\n";
+		return 0;
+	}
+	else {
+		arguments.assign(argv + 1, argv + argc);
+	}
+
+	std::vector<char> workingDirectory(4096);
+	while(getcwd(workingDirectory.data(), workingDirectory.size()) == nullptr)
+	{
+		if(errno != ERANGE)
+			throw std::runtime_error(std::string("Could not get working directory: ") + strerror(errno));
+		workingDirectory.resize(workingDirectory.size() * 2);
+	}
+
+	const std::string socketPath = DaemonProtocol::DefaultSocketPath();
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if(socketPath.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("Socket path is too long: " + socketPath);
+	strcpy(address.sun_path, socketPath.c_str());
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		std::cerr << "Could not connect to apertoolsd at " << socketPath << ": " << strerror(errno) << '\n';
+		return 1;
+	}
+	// The job is sent to and the output and exit status are taken from the other
+	// side, so it should be a daemon of this user (the socket may be in /tmp).
+	const uid_t peerUid = DaemonProtocol::PeerUid(fd);
+	if(peerUid != getuid())
+	{
+		std::cerr << "The process listening on " << socketPath << " belongs to user " << peerUid << ", not to this user\n";
+		close(fd);
+		return 1;
+	}
+
+	DaemonProtocol::WriteMessage(fd, DaemonProtocol::JobMessage, DaemonProtocol::MakeJob(workingDirectory.data(), arguments));
+	DaemonProtocol::MessageType type;
+	std::string payload;
+	while(DaemonProtocol::ReadMessage(fd, type, payload))
+	{
+		switch(type)
+		{
+			case DaemonProtocol::OutputMessage:
+				std::cout << payload << std::flush;
+				break;
+			case DaemonProtocol::ErrorMessage:
+				std::cerr << payload << std::flush;
+				break;
+			case DaemonProtocol::StatusMessage:
+				close(fd);
+				return atoi(payload.c_str());
+			default:
+				throw std::runtime_error("Invalid message from apertoolsd");
+		}
+	}
+	close(fd);
+	std::cerr << "apertoolsd closed the connection before the job finished\n";
+	return 1;
+}
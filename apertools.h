@@ -0,0 +1,35 @@
+#ifndef APERTOOLS_H
+#define APERTOOLS_H
+
+/**
+ * Public interface of libapertools. Programs that link to the library
+ * include this header, which gives the FITS reader and writer, the image
+ * class, the coordinate conversions and the in-memory beam operations:
+ * BeamGenerator calculates a beam and BeamCorrection applies one, both on
+ * buffers provided by the caller. C programs use apertoolsc.h instead.
+ *
+ * The major version is increased whenever a change to these classes breaks
+ * existing callers, which also changes the SOVERSION of the shared library.
+ */
+#define APERTOOLS_VERSION_MAJOR 1
+#define APERTOOLS_VERSION_MINOR 0
+
+#include "beamcorrection.h"
+#include "beamgenerator.h"
+#include "beamkernel.h"
+#include "beammodel.h"
+#include "fitsplaneiterator.h"
+#include "fitsreader.h"
+#include "fitstileiterator.h"
+#include "fitswriter.h"
+#include "image.h"
+#include "mappedfitsimage.h"
+#include "metadataindex.h"
+#include "polarization.h"
+
+#include "units/angle.h"
+#include "units/imagecoordinates.h"
+#include "units/ncpprojection.h"
+#include "units/radeccoord.h"
+
+#endif
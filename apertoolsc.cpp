@@ -0,0 +1,214 @@
+#include "apertoolsc.h"
+
+#include "beamcorrection.h"
+#include "beamgenerator.h"
+#include "beammodel.h"
+#include "image.h"
+
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+	thread_local std::string lastError;
+	
+	/**
+	 * Run a function and convert an exception into the error code of the C
+	 * interface, since exceptions can not pass through C code.
+	 */
+	template<typename Function>
+	int handleErrors(Function function)
+	{
+		try {
+			function();
+			return 0;
+		} catch(std::exception& e) {
+			lastError = e.what();
+		} catch(...) {
+			lastError = "Unknown error";
+		}
+		return -1;
+	}
+	
+	void checkPointer(const void* pointer, const char* name)
+	{
+		if(pointer == nullptr)
+			throw std::runtime_error(std::string("Parameter ") + name + " is NULL");
+	}
+	
+	BeamCorrection::Mode toCorrectionMode(enum apertools_correction_mode mode)
+	{
+		switch(mode)
+		{
+			case APERTOOLS_SQUARED_CORRECTION: return BeamCorrection::SquaredMode;
+			case APERTOOLS_NOT_SQUARED_CORRECTION: return BeamCorrection::NotSquaredMode;
+			case APERTOOLS_WEIGHT_CORRECTION: return BeamCorrection::WeightMode;
+		}
+		throw std::runtime_error("Invalid correction mode");
+	}
+	
+	BeamModel toBeamModel(const apertools_beam_model* model)
+	{
+		BeamModel result;
+		switch(model->type)
+		{
+			case APERTOOLS_WSRT_BEAM: result.SetType(BeamModel::WSRT); break;
+			case APERTOOLS_GAUSSIAN_BEAM: result.SetType(BeamModel::Gaussian); break;
+			case APERTOOLS_AIRY_BEAM: result.SetType(BeamModel::Airy); break;
+			case APERTOOLS_POLYNOMIAL_BEAM: result.SetType(BeamModel::Polynomial); break;
+			default: throw std::runtime_error("Invalid beam model type");
+		}
+		// Same checks as for the command line, so that no model silently gives a wrong beam
+		if((result.GetType() == BeamModel::Gaussian || result.GetType() == BeamModel::Airy) &&
+			!(model->dish_diameter > 0.0 && std::isfinite(model->dish_diameter)))
+			throw std::runtime_error("Invalid dish diameter");
+		result.SetDishDiameter(model->dish_diameter);
+		if(model->coefficients != nullptr)
+		{
+			if(model->n_coefficients > PolynomialBeamModel::MaxCoefficients)
+				throw std::runtime_error("Too many polynomial coefficients");
+			result.SetCoefficients(std::vector<double>(model->coefficients, model->coefficients + model->n_coefficients));
+		}
+		return result;
+	}
+	
+	template<typename NumType>
+	void generateBeam(const apertools_geometry* geometry, const apertools_beam_model* model,
+		double frequencyHz, NumType* beam, NumType* weight, size_t nThreads)
+	{
+		checkPointer(geometry, "geometry");
+		checkPointer(model, "model");
+		checkPointer(beam, "beam");
+		FitsIOChecker::Projection projection;
+		switch(geometry->projection)
+		{
+			case APERTOOLS_SIN_PROJECTION: projection = FitsIOChecker::SINProjection; break;
+			case APERTOOLS_NCP_PROJECTION: projection = FitsIOChecker::NCPProjection; break;
+			default: throw std::runtime_error("Invalid projection");
+		}
+		if(geometry->width == 0 || geometry->height == 0)
+			throw std::runtime_error("Invalid image size");
+		BeamGenerator generator(geometry->width, geometry->height,
+			geometry->pixel_size_x, geometry->pixel_size_y, projection,
+			geometry->phase_centre_dec, geometry->phase_centre_dl, geometry->phase_centre_dm);
+		generator.SetModel(toBeamModel(model));
+		generator.SetNThreads(nThreads);
+		// Row by row, to write directly into the buffers of the caller
+		generator.GenerateRows(frequencyHz, 0, geometry->height, beam, weight);
+	}
+	
+	template<typename NumType>
+	void imageStatistics(const NumType* data, size_t n, NumType* scratch, apertools_statistics* statistics)
+	{
+		checkPointer(data, "data");
+		checkPointer(statistics, "statistics");
+		if(n == 0)
+			throw std::runtime_error("No values given");
+		// All statistics only use the finite values, see ImageT::NFinite()
+		const double nan = std::numeric_limits<double>::quiet_NaN();
+		statistics->n_finite = ImageT<NumType>::NFinite(data, n);
+		statistics->sum = ImageT<NumType>::Sum(data, n);
+		statistics->mean = ImageT<NumType>::Average(data, n);
+		statistics->min = ImageT<NumType>::Min(data, n);
+		statistics->max = ImageT<NumType>::Max(data, n);
+		statistics->rms = ImageT<NumType>::RMS(data, n);
+		if(scratch != nullptr && statistics->n_finite != 0)
+		{
+			statistics->median = ImageT<NumType>::Median(data, n, scratch);
+			statistics->mad = ImageT<NumType>::MAD(data, n, scratch);
+			statistics->stddev_from_mad = ImageT<NumType>::StdDevFromMAD(data, n, scratch);
+		}
+		else {
+			statistics->median = nan;
+			statistics->mad = nan;
+			statistics->stddev_from_mad = nan;
+		}
+	}
+}
+
+const char* apertools_last_error(void)
+{
+	return lastError.c_str();
+}
+
+int apertools_generate_beam(const apertools_geometry* geometry, const apertools_beam_model* model,
+	double frequency_hz, double* beam, double* weight, size_t n_threads)
+{
+	return handleErrors([&]() { generateBeam(geometry, model, frequency_hz, beam, weight, n_threads); });
+}
+
+int apertools_generate_beam_f(const apertools_geometry* geometry, const apertools_beam_model* model,
+	double frequency_hz, float* beam, float* weight, size_t n_threads)
+{
+	return handleErrors([&]() { generateBeam(geometry, model, frequency_hz, beam, weight, n_threads); });
+}
+
+int apertools_correct(double* image, const double* beam, size_t n,
+	enum apertools_correction_mode mode, size_t n_threads)
+{
+	return handleErrors([&]() {
+		checkPointer(image, "image");
+		checkPointer(beam, "beam");
+		BeamCorrection(toCorrectionMode(mode), n_threads).Apply(image, beam, n);
+	});
+}
+
+int apertools_correct_f(float* image, const float* beam, size_t n,
+	enum apertools_correction_mode mode, size_t n_threads)
+{
+	return handleErrors([&]() {
+		checkPointer(image, "image");
+		checkPointer(beam, "beam");
+		BeamCorrection(toCorrectionMode(mode), n_threads).Apply(image, beam, n);
+	});
+}
+
+int apertools_prepare_beam(double* beam, size_t n,
+	enum apertools_correction_mode mode, size_t n_threads)
+{
+	return handleErrors([&]() {
+		checkPointer(beam, "beam");
+		BeamCorrection(toCorrectionMode(mode), n_threads).Prepare(beam, n);
+	});
+}
+
+int apertools_prepare_beam_f(float* beam, size_t n,
+	enum apertools_correction_mode mode, size_t n_threads)
+{
+	return handleErrors([&]() {
+		checkPointer(beam, "beam");
+		BeamCorrection(toCorrectionMode(mode), n_threads).Prepare(beam, n);
+	});
+}
+
+int apertools_apply_prepared(double* image, const double* divisor, size_t n, size_t n_threads)
+{
+	return handleErrors([&]() {
+		checkPointer(image, "image");
+		checkPointer(divisor, "divisor");
+		// The divisor already includes the mode
+		BeamCorrection(BeamCorrection::NotSquaredMode, n_threads).ApplyPrepared(image, divisor, n);
+	});
+}
+
+int apertools_apply_prepared_f(float* image, const float* divisor, size_t n, size_t n_threads)
+{
+	return handleErrors([&]() {
+		checkPointer(image, "image");
+		checkPointer(divisor, "divisor");
+		BeamCorrection(BeamCorrection::NotSquaredMode, n_threads).ApplyPrepared(image, divisor, n);
+	});
+}
+
+int apertools_image_statistics(const double* data, size_t n, double* scratch, apertools_statistics* statistics)
+{
+	return handleErrors([&]() { imageStatistics(data, n, scratch, statistics); });
+}
+
+int apertools_image_statistics_f(const float* data, size_t n, float* scratch, apertools_statistics* statistics)
+{
+	return handleErrors([&]() { imageStatistics(data, n, scratch, statistics); });
+}
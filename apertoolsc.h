@@ -0,0 +1,127 @@
+#ifndef APERTOOLS_C_H
+#define APERTOOLS_C_H
+
+/*
+ * C interface of libapertools, for programs that hold images in memory.
+ * All functions work directly on the buffers of the caller: images are
+ * row-major arrays of width x height pixels, and the pixel data is never
+ * copied or allocated by the library.
+ *
+ * Functions return 0 on success and -1 on failure, in which case
+ * apertools_last_error() describes the problem. The functions can be called
+ * from several threads at the same time, as long as they do not write to
+ * the same buffers.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum apertools_projection {
+	APERTOOLS_SIN_PROJECTION,
+	APERTOOLS_NCP_PROJECTION
+};
+
+enum apertools_beam_model_type {
+	APERTOOLS_WSRT_BEAM,
+	APERTOOLS_GAUSSIAN_BEAM,
+	APERTOOLS_AIRY_BEAM,
+	APERTOOLS_POLYNOMIAL_BEAM
+};
+
+enum apertools_correction_mode {
+	/* Divide by the beam squared */
+	APERTOOLS_SQUARED_CORRECTION,
+	/* Divide by the beam */
+	APERTOOLS_NOT_SQUARED_CORRECTION,
+	/* The beam image is a weight image; divide by its square root */
+	APERTOOLS_WEIGHT_CORRECTION
+};
+
+/*
+ * Geometry of an image, with the same meaning as the values that apbeam
+ * reads from the FITS header. Angles are in radians.
+ */
+typedef struct apertools_geometry {
+	size_t width, height;
+	double pixel_size_x, pixel_size_y;
+	enum apertools_projection projection;
+	double phase_centre_dec;
+	/* Shift of the image centre from the phase centre (usually zero) */
+	double phase_centre_dl, phase_centre_dm;
+} apertools_geometry;
+
+typedef struct apertools_beam_model {
+	enum apertools_beam_model_type type;
+	/* Dish diameter in meters for the Gaussian and Airy models; must be positive */
+	double dish_diameter;
+	/* Coefficients G1, G2, ... of the polynomial model (at most 8), or NULL for
+	 * the VLA values */
+	const double* coefficients;
+	size_t n_coefficients;
+} apertools_beam_model;
+
+/*
+ * Statistics of the finite values; NaN and infinite values, like the NaNs
+ * that a correction leaves where the beam is small, are skipped. Values
+ * are accumulated in double precision, also for single-precision data.
+ * Without finite values, the sum is 0 and the other fields are NaN.
+ */
+typedef struct apertools_statistics {
+	/* Number of finite values */
+	size_t n_finite;
+	double sum, mean, min, max, rms;
+	/* NaN when no scratch buffer was given */
+	double median, mad, stddev_from_mad;
+} apertools_statistics;
+
+/*
+ * Description of the last error in the calling thread.
+ */
+const char* apertools_last_error(void);
+
+/*
+ * Calculate the primary beam at the given frequency, as apbeam does.
+ * beam and (when not NULL) weight are images of the given geometry; weight
+ * receives the squared beam.
+ */
+int apertools_generate_beam(const apertools_geometry* geometry, const apertools_beam_model* model,
+	double frequency_hz, double* beam, double* weight, size_t n_threads);
+int apertools_generate_beam_f(const apertools_geometry* geometry, const apertools_beam_model* model,
+	double frequency_hz, float* beam, float* weight, size_t n_threads);
+
+/*
+ * Correct n pixels of an image in place for the primary beam, as applybeam
+ * does. Pixels where the absolute beam value is below 0.01 become NaN.
+ */
+int apertools_correct(double* image, const double* beam, size_t n,
+	enum apertools_correction_mode mode, size_t n_threads);
+int apertools_correct_f(float* image, const float* beam, size_t n,
+	enum apertools_correction_mode mode, size_t n_threads);
+
+/*
+ * Convert a beam in place into the divisor that apertools_apply_prepared()
+ * uses, for when the same beam corrects many images.
+ */
+int apertools_prepare_beam(double* beam, size_t n,
+	enum apertools_correction_mode mode, size_t n_threads);
+int apertools_prepare_beam_f(float* beam, size_t n,
+	enum apertools_correction_mode mode, size_t n_threads);
+
+int apertools_apply_prepared(double* image, const double* divisor, size_t n, size_t n_threads);
+int apertools_apply_prepared_f(float* image, const float* divisor, size_t n, size_t n_threads);
+
+/*
+ * Statistics of n values. The median and MAD need a scratch buffer of n
+ * values, which may be NULL to skip them.
+ */
+int apertools_image_statistics(const double* data, size_t n, double* scratch, apertools_statistics* statistics);
+int apertools_image_statistics_f(const float* data, size_t n, float* scratch, apertools_statistics* statistics);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,280 @@
+#include "daemonprotocol.h"
+#include "tools.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+	volatile sig_atomic_t stopRequested = 0;
+
+	void requestStop(int)
+	{
+		stopRequested = 1;
+	}
+
+	int runTool(std::vector<std::string>& arguments)
+	{
+		std::vector<char*> argv;
+		for(std::string& argument : arguments)
+			argv.push_back(&argument[0]);
+		argv.push_back(nullptr);
+		const int argc = arguments.size();
+		const std::string& tool = arguments.front();
+		if(tool == "apbeam")
+			return RunApBeam(argc, argv.data());
+		else if(tool == "applybeam")
+			return RunApplyBeam(argc, argv.data());
+		else if(tool == "apindex")
+			return RunApIndex(argc, argv.data());
+		else
+			throw std::runtime_error("Unknown tool: " + tool);
+	}
+
+	/**
+	 * Run the job of one client. The output of the tool is sent to the client
+	 * by redirecting std::cout and std::cerr, which is possible because a
+	 * worker process runs one job at a time.
+	 */
+	void handleConnection(int connection)
+	{
+		int status = 1;
+		DaemonMessageBuffer output(connection, DaemonProtocol::OutputMessage);
+		DaemonMessageBuffer errors(connection, DaemonProtocol::ErrorMessage);
+		std::streambuf* const coutBuffer = std::cout.rdbuf(&output);
+		std::streambuf* const cerrBuffer = std::cerr.rdbuf(&errors);
+		try {
+			DaemonProtocol::MessageType type;
+			std::string payload, workingDirectory;
+			std::vector<std::string> arguments;
+			if(!DaemonProtocol::ReadMessage(connection, type, payload))
+				throw std::runtime_error("No job received");
+			if(type != DaemonProtocol::JobMessage)
+				throw std::runtime_error("Expected a job message");
+			DaemonProtocol::ParseJob(payload, workingDirectory, arguments);
+			// Relative filenames are relative to the directory of the client
+			if(chdir(workingDirectory.c_str()) != 0)
+				throw std::runtime_error("Could not change to directory " + workingDirectory + ": " + strerror(errno));
+			status = runTool(arguments);
+		} catch(std::exception& e) {
+			std::cerr << "Error: " << e.what() << '\n';
+		}
+		std::cout.flush();
+		std::cerr.flush();
+		std::cout.rdbuf(coutBuffer);
+		std::cerr.rdbuf(cerrBuffer);
+		try {
+			DaemonProtocol::WriteMessage(connection, DaemonProtocol::StatusMessage, std::to_string(status));
+		} catch(std::exception&) {
+			// The client went away
+		}
+		if(chdir("/") != 0)
+			std::cerr << "Could not change to the root directory\n";
+	}
+
+	void runWorker(int listenSocket)
+	{
+		std::signal(SIGTERM, SIG_DFL);
+		std::signal(SIGINT, SIG_DFL);
+		for(;;)
+		{
+			int connection = accept(listenSocket, nullptr, nullptr);
+			if(connection < 0)
+			{
+				if(errno == EINTR || errno == ECONNABORTED)
+					continue;
+				std::cerr << "accept() failed: " << strerror(errno) << '\n';
+				_exit(1);
+			}
+			// A client that connects but sends no job would otherwise block the worker
+			timeval timeout;
+			timeout.tv_sec = DaemonProtocol::JobTimeoutSeconds;
+			timeout.tv_usec = 0;
+			setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+			handleConnection(connection);
+			close(connection);
+		}
+	}
+
+	pid_t startWorker(int listenSocket)
+	{
+		pid_t pid = fork();
+		if(pid < 0)
+			throw std::runtime_error(std::string("fork() failed: ") + strerror(errno));
+		if(pid == 0)
+		{
+			runWorker(listenSocket);
+			_exit(0);
+		}
+		return pid;
+	}
+
+	/**
+	 * Create a directory and its missing parents, like mkdir -p.
+	 */
+	bool createDirectories(const std::string& path)
+	{
+		for(size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1))
+		{
+			const std::string directory = path.substr(0, slash);
+			if(mkdir(directory.c_str(), 0700) != 0 && errno != EEXIST)
+				return false;
+			if(slash == std::string::npos)
+				return true;
+		}
+	}
+
+	int openSocket(const std::string& path)
+	{
+		sockaddr_un address;
+		memset(&address, 0, sizeof(address));
+		address.sun_family = AF_UNIX;
+		if(path.size() >= sizeof(address.sun_path))
+			throw std::runtime_error("Socket path is too long: " + path);
+		strcpy(address.sun_path, path.c_str());
+
+		int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(fd < 0)
+			throw std::runtime_error(std::string("Could not create socket: ") + strerror(errno));
+		// A socket file that nobody listens on is left over from an earlier run
+		if(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+		{
+			close(fd);
+			throw std::runtime_error("Another apertoolsd is already listening on " + path);
+		}
+		unlink(path.c_str());
+		// Jobs run with the permissions of the daemon, so only its user may connect
+		mode_t oldMask = umask(0077);
+		const bool bound = bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+		umask(oldMask);
+		if(!bound || listen(fd, 64) != 0)
+		{
+			const std::string error = strerror(errno);
+			close(fd);
+			throw std::runtime_error("Could not listen on " + path + ": " + error);
+		}
+		return fd;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	std::string socketPath = DaemonProtocol::DefaultSocketPath();
+	std::string distanceCache;
+	size_t nWorkers = 4, cacheSize = 4;
+	int argi = 1;
+	while(argi < argc && argv[argi][0] == '-')
+	{
+		std::string p(&argv[argi][1]);
+		if(p == "socket")
+		{
+			++argi;
+			socketPath = argv[argi];
+		}
+		else if(p == "workers")
+		{
+			++argi;
+			nWorkers = atoi(argv[argi]);
+			if(nWorkers == 0)
+				throw std::runtime_error("Invalid number of workers");
+		}
+		else if(p == "cache-size")
+		{
+			++argi;
+			cacheSize = atoi(argv[argi]);
+		}
+		else if(p == "distance-cache")
+		{
+			++argi;
+			distanceCache = argv[argi];
+		}
+		else if(p == "help")
+		{
+			std::cout <<
+				"Syntax: apertoolsd [options]\n"
+				"Runs apbeam, applybeam and apindex jobs that are submitted with apclient, without\n"
+				"starting a new process for every job. Worker processes stay resident, and each keeps\n"
+				"the beam generators of recent image geometries in memory. A job goes to whichever\n"
+				"worker is free, so a job only reuses a generator when its worker ran the same geometry\n"
+				"before, and otherwise every worker calculates the distances of a geometry once. With\n"
+				"-distance-cache, the workers share the distance maps on disk, so that they are\n"
+				"calculated once in total; an apbeam job with its own -distance-cache uses that instead.\n"
+				"Without it, jobs give the same output as running apbeam directly.\n"
+				"The daemon stops on SIGTERM or SIGINT.\n"
+				"Options:\n"
+				"\t-socket <path>\n"
+				"\t\tUnix socket to listen on. Default: $APERTOOLSD_SOCKET, or apertoolsd.socket in\n"
+				"\t\t$XDG_RUNTIME_DIR, or /tmp/apertoolsd-<uid>.socket.\n"
+				"\t-workers <n>\n"
+				"\t\tNumber of jobs that run at the same time. Each job uses the number of threads\n"
+				"\t\tgiven by its own -threads option. Default: 4.\n"
+				"\t-cache-size <n>\n"
+				"\t\tNumber of image geometries of which each worker keeps the beam generator. Default: 4.\n"
+				"\t-distance-cache <directory>\n"
+				"\t\tDirectory in which the workers share distance maps. The maps are stored in single\n"
+				"\t\tprecision, so the beams differ slightly from the ones that apbeam calculates without\n"
+				"\t\ta cache. The directory should not be writable by other users. Default: none; every\n"
+				"\t\tworker calculates the distances in double precision.\n";
+			return 0;
+		}
+		else throw std::runtime_error("Bad parameter");
+		++argi;
+	}
+
+	SetApBeamCacheSize(cacheSize);
+	if(!distanceCache.empty() && !createDirectories(distanceCache))
+	{
+		std::cerr << "Could not create " << distanceCache << ": " << strerror(errno) << "; distance maps are not shared\n";
+		distanceCache.clear();
+	}
+	SetApBeamDefaultDistanceCache(distanceCache);
+	const int listenSocket = openSocket(socketPath);
+
+	// Workers are started before any thread exists, so fork() is safe. Jobs
+	// run in the workers, which are restarted when they die.
+	std::signal(SIGPIPE, SIG_IGN);
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = requestStop;
+	sigaction(SIGTERM, &action, nullptr);
+	sigaction(SIGINT, &action, nullptr);
+
+	std::set<pid_t> workers;
+	for(size_t i=0; i!=nWorkers; ++i)
+		workers.insert(startWorker(listenSocket));
+	std::cout << "apertoolsd listening on " << socketPath << " with " << nWorkers << " workers\n";
+
+	while(!stopRequested)
+	{
+		int status;
+		pid_t pid = waitpid(-1, &status, 0);
+		if(pid > 0 && workers.erase(pid) != 0 && !stopRequested)
+		{
+			std::cerr << "Worker " << pid << " stopped, starting a new one\n";
+			// Avoid a busy loop when workers fail right away
+			sleep(1);
+			workers.insert(startWorker(listenSocket));
+		}
+	}
+
+	for(pid_t pid : workers)
+		kill(pid, SIGTERM);
+	for(pid_t pid : workers)
+		waitpid(pid, nullptr, 0);
+	close(listenSocket);
+	unlink(socketPath.c_str());
+	return 0;
+}
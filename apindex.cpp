@@ -0,0 +1,70 @@
+#include "metadataindex.h"
+#include "parallelfor.h"
+#include "tools.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+int RunApIndex(int argc, char* argv[])
+{
+	if(argc < 2)
+	{
+		std::cout <<
+			"Syntax: apindex [options] <catalogue.csv> <fits1> [<fits2> ...]\n"
+			"Write a catalogue with the header metadata (size, frequency, date, pointing,\n"
+			"pixel scale, beam, polarization) of a collection of FITS images. When the\n"
+			"catalogue already exists, only files that are new or of which the size or\n"
+			"modification time has changed are read again. Files that are not given are\n"
+			"removed from the catalogue.\n"
+			"Options:\n"
+			"\t-list <file>\n"
+			"\t\tRead the list of images from a file with one filename per line, in\n"
+			"\t\taddition to those on the command line.\n"
+			"\t-threads <n>\n"
+			"\t\tNumber of files that are read at the same time. Default: number of CPUs.\n";
+		return 0;
+	}
+	
+	size_t nThreads = ParallelFor::HardwareThreads();
+	std::vector<std::string> filenames;
+	int argi = 1;
+	while(argi < argc && argv[argi][0] == '-')
+	{
+		std::string p(&argv[argi][1]);
+		if(p == "threads")
+		{
+			++argi;
+			nThreads = atoi(argv[argi]);
+		}
+		else if(p == "list")
+		{
+			++argi;
+			std::ifstream list(argv[argi]);
+			if(!list)
+				throw std::runtime_error(std::string("Could not open list file ") + argv[argi]);
+			std::string line;
+			while(std::getline(list, line))
+			{
+				if(!line.empty() && line[0] != '#')
+					filenames.push_back(line);
+			}
+		}
+		else throw std::runtime_error("Bad parameter");
+		++argi;
+	}
+	if(argi >= argc)
+		throw std::runtime_error("Not enough parameters");
+	const std::string catalogue = argv[argi];
+	++argi;
+	for(; argi != argc; ++argi)
+		filenames.push_back(argv[argi]);
+	
+	MetadataIndex index;
+	index.Read(catalogue);
+	size_t nScanned = index.Update(filenames, nThreads);
+	index.Write(catalogue);
+	std::cout << "Catalogue has " << index.Entries().size() << " images, " << nScanned << " were (re)read.\n";
+	return 0;
+}
@@ -1,21 +1,338 @@
+#include "beamcorrection.h"
+#include "beamgenerator.h"
+#include "beammodel.h"
+#include "fitsplaneiterator.h"
 #include "fitsreader.h"
 #include "fitswriter.h"
+#include "image.h"
+#include "mappedfitsimage.h"
+#include "parallelfor.h"
+#include "tools.h"
 
+#include "uvector.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <iostream>
-#include <limits>
-#include <vector>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+/**
+ * Number of rows that are processed at a time when no block size is given:
+ * about one million pixels.
+ */
+static size_t defaultBlockRows(size_t width)
+{
+	return std::max<size_t>(1, (1024*1024) / width);
+}
+
+/**
+ * Read a manifest file with on every line an input and output filename,
+ * separated by whitespace. Empty lines and lines starting with '#' are
+ * skipped.
+ */
+static std::vector<std::pair<std::string, std::string>> readManifest(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if(!file)
+		throw std::runtime_error("Could not open manifest file " + filename);
+	std::vector<std::pair<std::string, std::string>> files;
+	std::string line;
+	while(std::getline(file, line))
+	{
+		std::istringstream lineStream(line);
+		std::string inpFits, outFits, rest;
+		if(!(lineStream >> inpFits) || inpFits[0] == '#')
+			continue;
+		if(!(lineStream >> outFits) || (lineStream >> rest))
+			throw std::runtime_error("Invalid line in manifest " + filename + ": " + line);
+		files.emplace_back(inpFits, outFits);
+	}
+	return files;
+}
+
+/**
+ * Correct a list of images with the same beam. The beam is read and
+ * converted with BeamCorrection::Prepare() once, after which up to nThreads
+ * files are corrected at the same time, each by a single thread. Every
+ * thread uses its own fitsfile pointers, which cfitsio only supports when it
+ * is built reentrant (configured with --enable-reentrant, which is not the
+ * default). Otherwise, the files are corrected one at a time, each with
+ * nThreads threads.
+ */
+template<typename NumType>
+static void correctBatch(const std::string& beamFits, const std::vector<std::pair<std::string, std::string>>& files, BeamCorrection::Mode mode, size_t blockRows, size_t nThreads)
+{
+	FitsReader beamReader(beamFits);
+	const size_t
+		width = beamReader.ImageWidth(),
+		height = beamReader.ImageHeight();
+	ImageT<NumType> divisor(width, height);
+	MappedFitsImage(beamReader).ReadIndex(divisor.data(), 0);
+	BeamCorrection(mode, nThreads).Prepare(divisor.data(), divisor.size());
+
+	if(blockRows == 0)
+		blockRows = defaultBlockRows(width);
+	blockRows = std::min(blockRows, height);
+
+	const size_t nFileThreads = fits_is_reentrant() ? nThreads : 1;
+	if(nFileThreads != nThreads)
+		std::cout << "cfitsio is not reentrant: correcting one file at a time.\n";
+	const BeamCorrection correction(mode, nFileThreads == 1 ? nThreads : 1);
+	std::mutex outputMutex;
+	ParallelFor(nFileThreads).Run(0, files.size(), [&](size_t fileIndex, size_t)
+	{
+		const std::string& inpFits = files[fileIndex].first;
+		const std::string& outFits = files[fileIndex].second;
+		FitsReader inpReader(inpFits);
+		if(inpReader.ImageWidth() != width || inpReader.ImageHeight() != height)
+			throw std::runtime_error("Beam and image " + inpFits + " do not have same size!");
+
+		FitsWriter writer(inpReader);
+		writer.StartMulti(outFits);
+		ao::uvector<NumType> imageBlock(width*blockRows);
+		for(size_t yStart=0; yStart<height; yStart+=blockRows)
+		{
+			const size_t nRows = std::min(blockRows, height-yStart);
+			inpReader.ReadRows(imageBlock.data(), yStart, nRows);
+			correction.ApplyPrepared(imageBlock.data(), &divisor[yStart*width], width*nRows);
+			writer.AddRowsToMulti(imageBlock.data(), nRows);
+		}
+		writer.FinishMulti();
+
+		std::lock_guard<std::mutex> lock(outputMutex);
+		std::cout << "Written " << outFits << '\n';
+	});
+}
+
+/**
+ * A block of full rows from one plane of an image cube.
+ */
+struct Block
+{
+	size_t image, yStart, nRows;
+};
+
+template<typename NumType>
+struct BlockBuffer
+{
+	ao::uvector<NumType> image, beam;
+};
+
+/**
+ * Reads, corrects and writes a list of blocks, such that I/O and
+ * calculations overlap. Two buffers are used: while the current block is
+ * calculated, a second thread writes the previous block from the other
+ * buffer and then reads the next block into it. Blocks are read and written
+ * in the order of the list.
+ */
+template<typename NumType>
+static void runPipeline(const std::vector<Block>& blocks, size_t bufferSize,
+	const std::function<void(const Block&, BlockBuffer<NumType>&)>& read,
+	const std::function<void(const Block&, BlockBuffer<NumType>&)>& calculate,
+	const std::function<void(const Block&, const BlockBuffer<NumType>&)>& write)
+{
+	if(blocks.empty())
+		return;
+	BlockBuffer<NumType> buffers[2];
+	for(BlockBuffer<NumType>& buffer : buffers)
+	{
+		buffer.image.resize(bufferSize);
+		buffer.beam.resize(bufferSize);
+	}
+	read(blocks[0], buffers[0]);
+	for(size_t i=0; i!=blocks.size(); ++i)
+	{
+		BlockBuffer<NumType>& current = buffers[i%2];
+		BlockBuffer<NumType>& other = buffers[(i+1)%2];
+		std::future<void> io = std::async(std::launch::async, [&]()
+		{
+			if(i != 0)
+				write(blocks[i-1], other);
+			if(i+1 != blocks.size())
+				read(blocks[i+1], other);
+		});
+		try {
+			calculate(blocks[i], current);
+		} catch(...) {
+			io.wait();
+			throw;
+		}
+		io.get();
+	}
+	write(blocks.back(), buffers[(blocks.size()-1)%2]);
+}
+
+/**
+ * Correct a single image or cube, either with a beam image or with a beam
+ * model when @p model is not null.
+ */
+template<typename NumType>
+static void correctFile(const std::string& inpFits, const std::string& beamFits, const std::string& outFits, BeamCorrection::Mode mode, const BeamModel* model, boost::optional<double> frequency, size_t blockRows, size_t readAhead, size_t nThreads)
+{
+	FitsReader inpReader(inpFits, true, true);
+	const size_t
+		width = inpReader.ImageWidth(),
+		height = inpReader.ImageHeight(),
+		nImages = inpReader.NImages();
+
+	// The images are processed in blocks of full rows, so that the memory use
+	// does not depend on the image height.
+	if(blockRows == 0)
+		blockRows = defaultBlockRows(width);
+	blockRows = std::min(blockRows, height);
+
+	const BeamCorrection correction(mode, nThreads);
+
+	std::unique_ptr<FitsReader> beamReader;
+	std::unique_ptr<MappedFitsImage> mappedBeam;
+	bool broadcastBeam = true;
+	std::unique_ptr<BeamGenerator> generator;
+	if(model == nullptr)
+	{
+		beamReader.reset(new FitsReader(beamFits, true, true));
+		if(beamReader->ImageWidth() != width || beamReader->ImageHeight() != height)
+			throw std::runtime_error("Beam and image do not have same size!");
+		// A single beam is applied to all planes, a beam cube plane by plane
+		if(beamReader->NImages() != 1)
+		{
+			if(beamReader->NImages() != nImages)
+				throw std::runtime_error("Beam should have one plane or the same number of planes as the image");
+			broadcastBeam = false;
+		}
+		// The beam is read-only input, and is often shared by many runs, so it is
+		// read from a memory mapping when possible.
+		mappedBeam.reset(new MappedFitsImage(*beamReader));
+	}
+	else {
+		// Calculate the beam one row at a time, the same way as apbeam does, so that
+		// no beam image needs to be written or held in memory.
+		std::cout << "Correcting with " << BeamModel::TypeName(model->GetType()) << " beam";
+		if(frequency)
+			std::cout << " at freq=" << frequency.get()*1e-6 << " MHz";
+		std::cout << '\n';
+		generator.reset(new BeamGenerator(inpReader));
+		generator->SetModel(*model);
+	}
+	if(nImages != 1)
+		std::cout << "Correcting " << nImages << " planes\n";
+
+	FitsWriter writer(inpReader);
+	writer.SetExtraDimensions(inpReader);
+	writer.StartMulti(outFits);
+
+	auto planeFrequency = [&](size_t image) -> double
+	{
+		return frequency ? frequency.get() : inpReader.PlaneFrequency(image);
+	};
+
+	// Optionally, whole planes are read ahead on a separate thread. The pipeline
+	// then takes its blocks from the planes that are already in memory, while its
+	// I/O thread writes and reads the beam. The reader and writer are used from
+	// different threads at the same time, which requires a reentrant cfitsio.
+	std::unique_ptr<FitsPlaneIterator<NumType>> planes;
+	if(readAhead != 0 && nImages != 1)
+	{
+		if(fits_is_reentrant())
+			planes.reset(new FitsPlaneIterator<NumType>(inpReader, readAhead+1));
+		else
+			std::cout << "cfitsio is not reentrant: not reading ahead.\n";
+	}
+
+	std::vector<Block> blocks;
+	for(size_t image=0; image!=nImages; ++image)
+	{
+		for(size_t yStart=0; yStart<height; yStart+=blockRows)
+			blocks.emplace_back(Block{image, yStart, std::min(blockRows, height-yStart)});
+	}
+
+	runPipeline<NumType>(blocks, width*blockRows,
+		[&](const Block& block, BlockBuffer<NumType>& buffer)
+		{
+			if(planes)
+			{
+				const NumType* plane = planes->Plane();
+				std::copy_n(plane + block.yStart*width, width*block.nRows, buffer.image.data());
+				if(block.yStart + block.nRows == height)
+					planes->Next();
+			}
+			else {
+				inpReader.ReadRows(buffer.image.data(), block.yStart, block.nRows, block.image);
+			}
+			if(mappedBeam)
+				mappedBeam->ReadRows(buffer.beam.data(), block.yStart, block.nRows, broadcastBeam ? 0 : block.image);
+		},
+		[&](const Block& block, BlockBuffer<NumType>& buffer)
+		{
+			if(!mappedBeam)
+				generator->GenerateRows(planeFrequency(block.image), block.yStart, block.nRows, buffer.beam.data());
+			correction.Apply(buffer.image.data(), buffer.beam.data(), width*block.nRows);
+		},
+		[&](const Block& block, const BlockBuffer<NumType>& buffer)
+		{
+			writer.AddRowsToMulti(buffer.image.data(), block.nRows);
+		});
+	writer.FinishMulti();
+}
 
-int main(int argc, char *argv[])
+int RunApplyBeam(int argc, char* argv[])
 {
-	if(argc < 4)
+	if(argc < 3)
 	{
-		std::cout << "Syntax: applybeam [-not-squared / -is-weight] <inpfits> <beamfits> <outfits>\n";
+		std::cout <<
+			"Syntax: applybeam [-not-squared / -is-weight] <inpfits> <beamfits> <outfits>\n"
+			"    or: applybeam -model <model> [model options] [-not-squared] <inpfits> <outfits>\n"
+			"    or: applybeam -batch [-not-squared / -is-weight] <beamfits> <inpfits1> <outfits1> [<inpfits2> <outfits2> ...]\n"
+			"    or: applybeam -manifest <file> [-not-squared / -is-weight] <beamfits>\n"
+			"The second form calculates the beam while correcting, instead of reading it from a file.\n"
+			"The last two forms correct many images with the same beam, which is read only once.\n"
+			"The input image can be a cube with frequency, polarization or time axes. The beam can\n"
+			"then be a single image, which is applied to all planes, or a cube with the same number\n"
+			"of planes. A beam model uses the frequency of each plane.\n"
+			"A manifest file lists on every line an input and output image.\n"
+			"Model options:\n"
+			"\t-model <wsrt / gaussian / airy / polynomial>\n"
+			"\t-frequency <MHz>\n"
+			"\t\tDefault: read from the input image.\n"
+			"\t-dish-diameter <meters>\n"
+			"\t\tDish diameter for the gaussian and airy models. Default: 25.\n"
+			"\t-coefficients <G1,G2,...>\n"
+			"\t\tCoefficients for the polynomial model (AIPS PBCOR). Default: VLA.\n"
+			"Other options:\n"
+			"\t-block-rows <n>\n"
+			"\t\tNumber of rows that are read, corrected and written at a time. Default: as many\n"
+			"\t\trows as fit in about one million pixels.\n"
+			"\t-read-ahead <n>\n"
+			"\t\tNumber of planes of a cube that are read ahead on a separate thread, on top of the\n"
+			"\t\tnext block that is always read while a block is corrected. This uses n+1 extra plane\n"
+			"\t\tbuffers, and is only done when cfitsio was built reentrant. Default: 0 (off).\n"
+			"\t-threads <n>\n"
+			"\t\tNumber of threads used for the correction. In batch mode, this is the number of\n"
+			"\t\tfiles that are corrected at the same time, if cfitsio was built reentrant.\n"
+			"\t\tDefault: number of CPUs.\n"
+			"\t-float\n"
+			"\t\tRead, correct and write the images in single precision, which halves the memory\n"
+			"\t\tuse and the amount of data moved. The FITS files themselves are single precision,\n"
+			"\t\tbut the correction is less accurate. Beam models are still evaluated in double precision.\n";
 		return 0;
 	}
-	
+
 	bool squared = true, isWeight = false;
+	bool useModel = false, batch = false, useFloat = false;
+	std::string manifest;
+	BeamModel model;
+	boost::optional<double> frequency;
+	size_t blockRows = 0, readAhead = 0;
+	size_t nThreads = ParallelFor::HardwareThreads();
 	int argi = 1;
 	while(argi < argc && argv[argi][0] == '-')
 	{
@@ -28,41 +345,112 @@ int main(int argc, char *argv[])
 		{
 			isWeight = true;
 		}
+		else if(p == "float")
+		{
+			useFloat = true;
+		}
+		else if(p == "batch")
+		{
+			batch = true;
+		}
+		else if(p == "manifest")
+		{
+			++argi;
+			manifest = argv[argi];
+			batch = true;
+		}
+		else if(p == "model")
+		{
+			++argi;
+			model.SetType(BeamModel::ParseType(argv[argi]));
+			useModel = true;
+		}
+		else if(p == "dish-diameter")
+		{
+			++argi;
+			model.SetDishDiameter(atof(argv[argi]));
+		}
+		else if(p == "coefficients")
+		{
+			++argi;
+			model.SetCoefficients(BeamModel::ParseCoefficients(argv[argi]));
+		}
+		else if(p == "frequency")
+		{
+			++argi;
+			frequency = atof(argv[argi])*1e6;
+		}
+		else if(p == "threads")
+		{
+			++argi;
+			nThreads = atoi(argv[argi]);
+		}
+		else if(p == "block-rows")
+		{
+			++argi;
+			blockRows = atoi(argv[argi]);
+			if(blockRows == 0)
+				throw std::runtime_error("Invalid block size");
+		}
+		else if(p == "read-ahead")
+		{
+			++argi;
+			readAhead = atoi(argv[argi]);
+		}
 		else throw std::runtime_error("Bad parameter");
 		++argi;
 	}
-	
-	const char *inpFits = argv[argi];
-	const char *beamFits = argv[argi+1];
-	const char *outFits = argv[argi+2];
-	
-	FitsReader inpReader(inpFits);
-	size_t
-		width = inpReader.ImageWidth(),
-		height = inpReader.ImageHeight();
-	FitsReader beamReader(beamFits);
-	if(beamReader.ImageWidth() != width || beamReader.ImageHeight() != height)
-		throw std::runtime_error("Beam and image do not have same size!");
-	
-	std::vector<double> inpImage(width*height), beamImage(width*height);
-	
-	inpReader.Read<double>(&inpImage[0]);
-	beamReader.Read<double>(&beamImage[0]);
-	
-	std::vector<double>::iterator beamIter = beamImage.begin();
-	for(std::vector<double>::iterator i=inpImage.begin(); i!=inpImage.end(); ++i)
+
+	BeamCorrection::Mode mode;
+	if(isWeight)
+		mode = BeamCorrection::WeightMode;
+	else if(squared)
+		mode = BeamCorrection::SquaredMode;
+	else
+		mode = BeamCorrection::NotSquaredMode;
+
+	if(batch)
 	{
-		if(std::fabs(*beamIter) < 1e-2)
-			*i = std::numeric_limits<double>::quiet_NaN();
-		else if(isWeight)
-			*i /= sqrt(*beamIter);
-		else if(squared)
-			*i /= *beamIter * *beamIter;
+		if(useModel)
+			throw std::runtime_error("A beam model can not be combined with batch mode");
+		if(argi >= argc)
+			throw std::runtime_error("Not enough parameters");
+		const std::string beamFits = argv[argi];
+		++argi;
+		std::vector<std::pair<std::string, std::string>> files;
+		if(!manifest.empty())
+		{
+			if(argi != argc)
+				throw std::runtime_error("Input and output files should be given either in the manifest or on the command line");
+			files = readManifest(manifest);
+		}
+		else {
+			if((argc - argi) % 2 != 0)
+				throw std::runtime_error("Every input file needs an output file");
+			for(; argi != argc; argi += 2)
+				files.emplace_back(argv[argi], argv[argi+1]);
+		}
+		if(files.empty())
+			throw std::runtime_error("No input files given");
+		if(useFloat)
+			correctBatch<float>(beamFits, files, mode, blockRows, nThreads);
 		else
-			*i /= *beamIter;
-		++beamIter;
+			correctBatch<double>(beamFits, files, mode, blockRows, nThreads);
+		return 0;
 	}
-	
-	FitsWriter writer(inpReader);
-	writer.Write<double>(outFits, &inpImage[0]);
+
+	const size_t nFiles = useModel ? 2 : 3;
+	if(argc - argi < int(nFiles))
+		throw std::runtime_error("Not enough parameters");
+	if(useModel && isWeight)
+		throw std::runtime_error("A beam model can not be combined with -is-weight");
+	const std::string inpFits = argv[argi];
+	const std::string beamFits = useModel ? std::string() : argv[argi+1];
+	const std::string outFits = argv[argi+nFiles-1];
+
+	if(useFloat)
+		correctFile<float>(inpFits, beamFits, outFits, mode, useModel ? &model : nullptr, frequency, blockRows, readAhead, nThreads);
+	else
+		correctFile<double>(inpFits, beamFits, outFits, mode, useModel ? &model : nullptr, frequency, blockRows, readAhead, nThreads);
+	return 0;
 }
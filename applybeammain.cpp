@@ -0,0 +1,6 @@
+#include "tools.h"
+
+int main(int argc, char* argv[])
+{
+	return RunApplyBeam(argc, argv);
+}
@@ -0,0 +1,162 @@
+#include "beamcorrection.h"
+
+#include "parallelfor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+constexpr double BeamCorrection::Threshold;
+
+namespace {
+	/**
+	 * Pixels are handed to threads in chunks of this size, which is large
+	 * enough to make the scheduling overhead negligible.
+	 */
+	constexpr size_t ChunkSize = 16384;
+	
+	template<BeamCorrection::Mode M, typename NumType>
+	inline NumType divisor(NumType beam)
+	{
+		switch(M)
+		{
+			case BeamCorrection::SquaredMode: return beam * beam;
+			case BeamCorrection::NotSquaredMode: return beam;
+			case BeamCorrection::WeightMode: return std::sqrt(beam);
+		}
+		return beam;
+	}
+}
+
+BeamCorrection::BeamCorrection(Mode mode, size_t nThreads) :
+	_mode(mode),
+	_nThreads(nThreads == 0 ? 1 : nThreads),
+	_doubleKernels(makeKernels<double>(mode)),
+	_floatKernels(makeKernels<float>(mode))
+{
+}
+
+template<typename NumType>
+BeamCorrection::Kernels<NumType> BeamCorrection::makeKernels(Mode mode)
+{
+	Kernels<NumType> kernels;
+	switch(mode)
+	{
+		case SquaredMode:
+			kernels.apply = &kernel<SquaredMode, NumType>;
+			kernels.prepare = &prepareKernel<SquaredMode, NumType>;
+			break;
+		case NotSquaredMode:
+			kernels.apply = &kernel<NotSquaredMode, NumType>;
+			kernels.prepare = &prepareKernel<NotSquaredMode, NumType>;
+			break;
+		case WeightMode:
+			kernels.apply = &kernel<WeightMode, NumType>;
+			kernels.prepare = &prepareKernel<WeightMode, NumType>;
+			break;
+	}
+	return kernels;
+}
+
+template<>
+const BeamCorrection::Kernels<double>& BeamCorrection::kernels<double>() const
+{
+	return _doubleKernels;
+}
+
+template<>
+const BeamCorrection::Kernels<float>& BeamCorrection::kernels<float>() const
+{
+	return _floatKernels;
+}
+
+/**
+ * The smallest value of NumType that is not below Threshold. For single
+ * precision, comparing with this value selects exactly the same pixels as
+ * comparing the (exactly converted) value with the double Threshold.
+ */
+template<typename NumType>
+NumType BeamCorrection::threshold()
+{
+	NumType t = NumType(Threshold);
+	if(t < Threshold)
+		t = std::nextafter(t, std::numeric_limits<NumType>::infinity());
+	return t;
+}
+
+template<BeamCorrection::Mode M, typename NumType>
+void BeamCorrection::kernel(NumType* __restrict__ image, const NumType* __restrict__ beam, size_t n)
+{
+	const NumType
+		nan = std::numeric_limits<NumType>::quiet_NaN(),
+		limit = threshold<NumType>();
+	// The division is also performed for pixels below the threshold, and the
+	// result is discarded with a select instead of a branch. This gives the same
+	// result as dividing only the pixels above the threshold: a NaN beam value
+	// fails the comparison and propagates through the division.
+	for(size_t i=0; i!=n; ++i)
+	{
+		const NumType corrected = image[i] / divisor<M>(beam[i]);
+		image[i] = (std::fabs(beam[i]) < limit) ? nan : corrected;
+	}
+}
+
+template<BeamCorrection::Mode M, typename NumType>
+void BeamCorrection::prepareKernel(NumType* __restrict__ beam, const NumType*, size_t n)
+{
+	const NumType
+		nan = std::numeric_limits<NumType>::quiet_NaN(),
+		limit = threshold<NumType>();
+	for(size_t i=0; i!=n; ++i)
+		beam[i] = (std::fabs(beam[i]) < limit) ? nan : divisor<M>(beam[i]);
+}
+
+template<typename NumType>
+void BeamCorrection::divideKernel(NumType* __restrict__ image, const NumType* __restrict__ divisor, size_t n)
+{
+	// A NaN divisor marks a pixel below the threshold, and always gives NaN
+	for(size_t i=0; i!=n; ++i)
+		image[i] /= divisor[i];
+}
+
+template void BeamCorrection::Apply(double* image, const double* beam, size_t n) const;
+template void BeamCorrection::Apply(float* image, const float* beam, size_t n) const;
+
+template<typename NumType>
+void BeamCorrection::Apply(NumType* image, const NumType* beam, size_t n) const
+{
+	run(kernels<NumType>().apply, image, beam, n);
+}
+
+template void BeamCorrection::Prepare(double* beam, size_t n) const;
+template void BeamCorrection::Prepare(float* beam, size_t n) const;
+
+template<typename NumType>
+void BeamCorrection::Prepare(NumType* beam, size_t n) const
+{
+	run(kernels<NumType>().prepare, beam, static_cast<const NumType*>(nullptr), n);
+}
+
+template void BeamCorrection::ApplyPrepared(double* image, const double* divisor, size_t n) const;
+template void BeamCorrection::ApplyPrepared(float* image, const float* divisor, size_t n) const;
+
+template<typename NumType>
+void BeamCorrection::ApplyPrepared(NumType* image, const NumType* divisor, size_t n) const
+{
+	run(&divideKernel<NumType>, image, divisor, n);
+}
+
+template<typename NumType>
+void BeamCorrection::run(typename Kernels<NumType>::Function kernelFunction, NumType* image, const NumType* beam, size_t n) const
+{
+	const size_t nChunks = (n + ChunkSize - 1) / ChunkSize;
+	if(_nThreads == 1 || nChunks <= 1)
+		kernelFunction(image, beam, n);
+	else {
+		ParallelFor(_nThreads).Run(0, nChunks, [&](size_t chunk, size_t)
+		{
+			const size_t start = chunk * ChunkSize;
+			kernelFunction(image + start, beam == nullptr ? nullptr : beam + start, std::min(ChunkSize, n - start));
+		});
+	}
+}
@@ -0,0 +1,91 @@
+#ifndef BEAM_CORRECTION_H
+#define BEAM_CORRECTION_H
+
+#include <cstddef>
+
+/**
+ * Divides an image by a beam, as done by applybeam. Pixels where the absolute
+ * beam value is below the threshold are set to NaN. The kernel for the
+ * selected mode is chosen once on construction; the per-pixel loop has no
+ * branches, so that it can be vectorized, and Apply() divides the pixels
+ * over multiple threads. Images can be corrected in double or single
+ * precision; both are instantiated for float and double.
+ */
+class BeamCorrection
+{
+public:
+	enum Mode {
+		/** Divide by the squared beam; the beam image holds voltages. */
+		SquaredMode,
+		/** Divide by the beam. */
+		NotSquaredMode,
+		/** Divide by the square root of the beam; the beam image holds weights. */
+		WeightMode
+	};
+	
+	explicit BeamCorrection(Mode mode, size_t nThreads = 1);
+	
+	/**
+	 * Correct @p n pixels of @p image in place with the corresponding values
+	 * of @p beam.
+	 */
+	template<typename NumType>
+	void Apply(NumType* image, const NumType* beam, size_t n) const;
+	
+	/**
+	 * Convert a beam in place into the values that images are divided by,
+	 * with NaN for pixels below the threshold. This is useful when the same
+	 * beam is applied to many images; ApplyPrepared() then only has to divide.
+	 * The result is identical to that of Apply().
+	 */
+	template<typename NumType>
+	void Prepare(NumType* beam, size_t n) const;
+	
+	/**
+	 * Correct @p n pixels of @p image with a beam that was converted with
+	 * Prepare().
+	 */
+	template<typename NumType>
+	void ApplyPrepared(NumType* image, const NumType* divisor, size_t n) const;
+	
+	Mode GetMode() const { return _mode; }
+	
+	/** Beam values with an absolute value below this are set to NaN. */
+	static constexpr double Threshold = 1e-2;
+	
+private:
+	template<typename NumType>
+	struct Kernels
+	{
+		typedef void (*Function)(NumType* image, const NumType* beam, size_t n);
+		Function apply, prepare;
+	};
+	
+	template<typename NumType>
+	static Kernels<NumType> makeKernels(Mode mode);
+	
+	template<Mode M, typename NumType>
+	static void kernel(NumType* image, const NumType* beam, size_t n);
+	
+	template<Mode M, typename NumType>
+	static void prepareKernel(NumType* beam, const NumType* unused, size_t n);
+	
+	template<typename NumType>
+	static void divideKernel(NumType* image, const NumType* divisor, size_t n);
+	
+	template<typename NumType>
+	static NumType threshold();
+	
+	template<typename NumType>
+	const Kernels<NumType>& kernels() const;
+	
+	template<typename NumType>
+	void run(typename Kernels<NumType>::Function kernelFunction, NumType* image, const NumType* beam, size_t n) const;
+	
+	Mode _mode;
+	size_t _nThreads;
+	Kernels<double> _doubleKernels;
+	Kernels<float> _floatKernels;
+};
+
+#endif
@@ -0,0 +1,270 @@
+#include "beamgenerator.h"
+
+#include "coarsegridinterpolator.h"
+#include "distancemapcache.h"
+#include "fitsreader.h"
+#include "parallelfor.h"
+#include "radiallookuptable.h"
+
+#include "units/angle.h"
+#include "units/imagecoordinates.h"
+
+#include <algorithm>
+
+BeamGenerator::BeamGenerator(size_t width, size_t height, double pixelSizeX, double pixelSizeY,
+	enum FitsIOChecker::Projection projection, double phaseCentreDec, double phaseCentreDL, double phaseCentreDM) :
+	_width(width), _height(height),
+	_pixelSizeX(pixelSizeX), _pixelSizeY(pixelSizeY),
+	_projection(projection),
+	_phaseCentreDec(phaseCentreDec), _phaseCentreDL(phaseCentreDL), _phaseCentreDM(phaseCentreDM),
+	_kernel(projection, phaseCentreDec, phaseCentreDL, phaseCentreDM),
+	_model(),
+	_nThreads(1),
+	_lookupTolerance(0.0),
+	_coarseStep(0),
+	_coarseTolerance(1e-6),
+	_cacheDirectory(),
+	_log(nullptr),
+	_lValues(width),
+	_distancesPrepared(false),
+	_nGenerated(0)
+{
+	// l only depends on the column and m only on the row, so l is calculated once for all rows
+	double mFirstRow = 0.0;
+	for(size_t x=0; x!=width; ++x)
+		ImageCoordinates::XYToLM(x, 0, pixelSizeX, pixelSizeY, width, height, _lValues[x], mFirstRow);
+	_kernel.DistanceRow(_lValues.data(), mFirstRow, &_maxAngle, 1);
+
+	// With the phase centre on the image centre, the SIN-projected beam is mirror symmetric
+	// in l and m, and only the first quadrant needs to be calculated.
+	_symmetric =
+		projection == FitsIOChecker::SINProjection &&
+		phaseCentreDL == 0.0 && phaseCentreDM == 0.0;
+	_computeWidth = _symmetric ? width/2 + 1 : width;
+	_computeHeight = _symmetric ? height/2 + 1 : height;
+
+	// The distance is largest in one of the corners. This is used to size the
+	// lookup table; any larger distance is still evaluated correctly by the table,
+	// albeit without speed-up.
+	_maxRadius = 0.0;
+	for(size_t y : { size_t(0), height-1 })
+	{
+		for(size_t x : { size_t(0), width-1 })
+		{
+			double l, m, distance;
+			ImageCoordinates::XYToLM(x, y, pixelSizeX, pixelSizeY, width, height, l, m);
+			_kernel.DistanceRow(&l, m, &distance, 1);
+			_maxRadius = std::max(_maxRadius, distance);
+		}
+	}
+}
+
+BeamGenerator::BeamGenerator(const FitsReader& reader) :
+	BeamGenerator(reader.ImageWidth(), reader.ImageHeight(),
+		reader.PixelSizeX(), reader.PixelSizeY(), reader.ProjectionType(),
+		reader.PhaseCentreDec(), reader.PhaseCentreDL(), reader.PhaseCentreDM())
+{
+}
+
+BeamGenerator::~BeamGenerator()
+{
+}
+
+void BeamGenerator::SetCoarseGrid(size_t step, double tolerance)
+{
+	// The coarse grid needs no distance map, the exact path does
+	if(step != _coarseStep)
+		resetDistances();
+	_coarseStep = step;
+	_coarseTolerance = tolerance;
+}
+
+void BeamGenerator::SetDistanceCache(const std::string& directory)
+{
+	if(directory != _cacheDirectory)
+		resetDistances();
+	_cacheDirectory = directory;
+}
+
+void BeamGenerator::resetDistances()
+{
+	_distancesPrepared = false;
+	_distanceMap.reset();
+	_distanceCache.reset();
+	// The row buffers depend on whether a cache is used
+	_distanceRows.clear();
+	_beamRows.clear();
+}
+
+void BeamGenerator::prepareDistances()
+{
+	if(_symmetric && _log)
+		*_log << "Beam is symmetric, calculating one quadrant.\n";
+
+	// The distances only depend on the geometry, so are calculated once for all channels.
+	// Each row is written by exactly one thread, and each pixel is calculated the same
+	// way as in a serial loop, so the result does not depend on the number of threads.
+	// When a cache is used, the single-precision distances from the cache file are used,
+	// also right after storing them, so that all runs give the same result.
+	if(_coarseStep == 0)
+	{
+		if(!_cacheDirectory.empty())
+		{
+			_distanceCache.reset(new DistanceMapCache(_cacheDirectory, _width, _height,
+				_pixelSizeX, _pixelSizeY, _projection, _phaseCentreDec, _phaseCentreDL, _phaseCentreDM));
+			if(_distanceCache->Open(_computeWidth, _computeHeight) && _log)
+				*_log << "Using cached distance map " << _distanceCache->Filename() << '\n';
+		}
+		if(!_distanceCache || _distanceCache->Data() == nullptr)
+		{
+			_distanceMap = Image(_computeWidth, _computeHeight);
+			ParallelFor(_nThreads).Run(0, _computeHeight, [&](size_t y, size_t)
+			{
+				double l, m;
+				ImageCoordinates::XYToLM<double>(0, y, _pixelSizeX, _pixelSizeY, _width, _height, l, m);
+				_kernel.DistanceRow(_lValues.data(), m, _distanceMap.data() + y*_computeWidth, _computeWidth);
+			});
+			if(_distanceCache)
+			{
+				ao::uvector<float> singleMap(_distanceMap.begin(), _distanceMap.end());
+				_distanceCache->Store(singleMap.data(), _computeWidth, _computeHeight);
+				_distanceMap.reset();
+				if(_log)
+					*_log << "Stored distance map in " << _distanceCache->Filename() << '\n';
+			}
+		}
+	}
+	_distancesPrepared = true;
+}
+
+template<typename NumType>
+void BeamGenerator::Generate(double frequencyHz, NumType* beam, NumType* weight)
+{
+	if(!_distancesPrepared)
+		prepareDistances();
+
+	ParallelFor loop(_nThreads);
+	if(_beamRows.size() != loop.NThreads())
+	{
+		_beamRows.assign(loop.NThreads(), ao::uvector<double>(_computeWidth));
+		if(_distanceCache)
+			_distanceRows.assign(loop.NThreads(), ao::uvector<double>(_computeWidth));
+	}
+
+	// The model for this frequency, for evaluating single distances
+	const std::function<double(double)> model = _model.Evaluator(frequencyHz);
+	std::unique_ptr<RadialLookupTable> lookupTable;
+	if(_lookupTolerance != 0.0)
+	{
+		lookupTable.reset(new RadialLookupTable(model, _maxRadius, _lookupTolerance));
+		if(_nGenerated == 0 && _log)
+			*_log << "Radial lookup table: " << lookupTable->Size() << " samples, step " << Angle::ToNiceString(lookupTable->Step()) << ", max error " << lookupTable->MaxError() << '\n';
+	}
+
+	if(_coarseStep != 0)
+	{
+		const double
+			midX = _width / 2.0,
+			midY = _height / 2.0;
+		auto evaluate = [&](double x, double y) -> double
+		{
+			// Same as ImageCoordinates::XYToLM(), for fractional pixel positions
+			double
+				l = (midX - x) * _pixelSizeX,
+				m = (y - midY) * _pixelSizeY,
+				distance;
+			_kernel.DistanceRow(&l, m, &distance, 1);
+			return lookupTable ? (*lookupTable)(distance) : model(distance);
+		};
+		CoarseGridInterpolator interpolator(_coarseStep, _coarseTolerance);
+		interpolator.Fill(beam, _computeWidth, _computeHeight, _width, evaluate, _nThreads);
+		if(_log)
+			*_log << "Coarse grid: max interpolation error " << interpolator.MaxError() << ", " <<
+				interpolator.NRefinedCells() << " of " << interpolator.NCells() << " cells evaluated exactly.\n";
+		if(_symmetric)
+			ImageT<NumType>::MirrorQuadrant(beam, _width, _height);
+		if(weight != nullptr)
+		{
+			for(size_t i=0; i!=_width*_height; ++i)
+			{
+				const double value = beam[i];
+				weight[i] = value * value;
+			}
+		}
+	}
+	else {
+		loop.Run(0, _computeHeight, [&](size_t y, size_t thread)
+		{
+			const double* distance;
+			if(_distanceCache)
+			{
+				const float* cachedRow = _distanceCache->Data() + y*_computeWidth;
+				double* row = _distanceRows[thread].data();
+				for(size_t x=0; x!=_computeWidth; ++x)
+					row[x] = cachedRow[x];
+				distance = row;
+			}
+			else {
+				distance = _distanceMap.data() + y*_computeWidth;
+			}
+			double* beamRow = _beamRows[thread].data();
+			if(lookupTable)
+				lookupTable->EvaluateRow(distance, beamRow, _computeWidth);
+			else
+				_model.EvaluateRow(frequencyHz, distance, beamRow, _computeWidth);
+			NumType* beamOutput = beam + y*_width;
+			for(size_t x=0; x!=_computeWidth; ++x)
+				beamOutput[x] = beamRow[x];
+			if(weight != nullptr)
+			{
+				NumType* weightOutput = weight + y*_width;
+				for(size_t x=0; x!=_computeWidth; ++x)
+					weightOutput[x] = beamRow[x] * beamRow[x];
+			}
+		});
+		if(_symmetric)
+		{
+			ImageT<NumType>::MirrorQuadrant(beam, _width, _height);
+			if(weight != nullptr)
+				ImageT<NumType>::MirrorQuadrant(weight, _width, _height);
+		}
+	}
+	++_nGenerated;
+}
+
+template
+void BeamGenerator::Generate(double frequencyHz, float* beam, float* weight);
+template
+void BeamGenerator::Generate(double frequencyHz, double* beam, double* weight);
+
+template<typename NumType>
+void BeamGenerator::GenerateRows(double frequencyHz, size_t yStart, size_t nRows, NumType* beam, NumType* weight) const
+{
+	ParallelFor loop(_nThreads);
+	std::vector<ao::uvector<double>>
+		distanceRows(loop.NThreads(), ao::uvector<double>(_width)),
+		beamRows(loop.NThreads(), ao::uvector<double>(_width));
+	loop.Run(yStart, yStart+nRows, [&](size_t y, size_t thread)
+	{
+		double* distance = distanceRows[thread].data();
+		double* beamRow = beamRows[thread].data();
+		double l, m;
+		ImageCoordinates::XYToLM<double>(0, y, _pixelSizeX, _pixelSizeY, _width, _height, l, m);
+		_kernel.DistanceRow(_lValues.data(), m, distance, _width);
+		_model.EvaluateRow(frequencyHz, distance, beamRow, _width);
+		NumType* beamOutput = beam + (y-yStart)*_width;
+		for(size_t x=0; x!=_width; ++x)
+			beamOutput[x] = beamRow[x];
+		if(weight != nullptr)
+		{
+			NumType* weightOutput = weight + (y-yStart)*_width;
+			for(size_t x=0; x!=_width; ++x)
+				weightOutput[x] = beamRow[x] * beamRow[x];
+		}
+	});
+}
+
+template
+void BeamGenerator::GenerateRows(double frequencyHz, size_t yStart, size_t nRows, float* beam, float* weight) const;
+template
+void BeamGenerator::GenerateRows(double frequencyHz, size_t yStart, size_t nRows, double* beam, double* weight) const;
@@ -0,0 +1,134 @@
+#ifndef BEAM_GENERATOR_H
+#define BEAM_GENERATOR_H
+
+#include "beamkernel.h"
+#include "beammodel.h"
+#include "fitsiochecker.h"
+#include "image.h"
+#include "uvector.h"
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Calculates primary-beam images in memory for a given image geometry. This
+ * is what apbeam does, without reading or writing files: the caller provides
+ * the output buffers, and can call Generate() for many frequencies. The
+ * distances to the phase centre only depend on the geometry, so are
+ * calculated on the first call and reused for later calls.
+ */
+class BeamGenerator
+{
+public:
+	/**
+	 * @param pixelSizeX Pixel size in radians. The phase centre parameters are
+	 * as in FitsReader.
+	 */
+	BeamGenerator(size_t width, size_t height, double pixelSizeX, double pixelSizeY,
+		enum FitsIOChecker::Projection projection, double phaseCentreDec, double phaseCentreDL, double phaseCentreDM);
+	
+	/**
+	 * Use the geometry of an image.
+	 */
+	explicit BeamGenerator(const class FitsReader& reader);
+	
+	~BeamGenerator();
+	
+	BeamGenerator(const BeamGenerator&) = delete;
+	BeamGenerator& operator=(const BeamGenerator&) = delete;
+	
+	const BeamModel& Model() const { return _model; }
+	void SetModel(const BeamModel& model) { _model = model; }
+	
+	/** Number of threads used by Generate(). Default: 1. */
+	void SetNThreads(size_t nThreads) { _nThreads = nThreads; }
+	
+	/**
+	 * Evaluate the beam by interpolating a radial lookup table with the given
+	 * maximum absolute error. Zero (the default) evaluates the model exactly.
+	 */
+	void SetLookupTolerance(double tolerance) { _lookupTolerance = tolerance; }
+	
+	/**
+	 * Evaluate the beam only every @p step pixels and interpolate in between,
+	 * see CoarseGridInterpolator. A step of zero (the default) turns this off.
+	 * Changing the step after Generate() has been called makes the next call
+	 * prepare the distances again.
+	 */
+	void SetCoarseGrid(size_t step, double tolerance);
+	
+	/**
+	 * Store and reuse the distance map in the given directory, see
+	 * DistanceMapCache. Not used together with a coarse grid. Like
+	 * SetCoarseGrid(), this may be changed between calls to Generate().
+	 */
+	void SetDistanceCache(const std::string& directory);
+	
+	/** Stream for progress messages, or nullptr (the default) for none. */
+	void SetLog(std::ostream* log) { _log = log; }
+	
+	/**
+	 * Calculate the beam and the weight (the squared beam) for one frequency.
+	 * @param beam Output image of Width() x Height().
+	 * @param weight Output image of the same size, or nullptr if not needed.
+	 */
+	template<typename NumType>
+	void Generate(double frequencyHz, NumType* beam, NumType* weight);
+	
+	/**
+	 * Calculate the beam for a block of full rows, evaluating the model exactly.
+	 * This does not use the cached distances, the lookup table or the coarse
+	 * grid, and needs no memory other than a few rows per thread. It is meant
+	 * for calculating a beam block by block while correcting an image, or
+	 * directly into a buffer of the caller.
+	 * @param beam Output of Width() x @p nRows.
+	 * @param weight Output for the squared beam of the same size, or nullptr.
+	 */
+	template<typename NumType>
+	void GenerateRows(double frequencyHz, size_t yStart, size_t nRows, NumType* beam, NumType* weight = nullptr) const;
+	
+	size_t Width() const { return _width; }
+	size_t Height() const { return _height; }
+	
+	/**
+	 * Whether the beam is mirror symmetric, in which case Generate() only
+	 * calculates one quadrant.
+	 */
+	bool IsSymmetric() const { return _symmetric; }
+	
+	/** Distance of the first pixel to the phase centre, in radians. */
+	double MaxAngle() const { return _maxAngle; }
+	
+private:
+	void prepareDistances();
+	void resetDistances();
+	
+	size_t _width, _height;
+	double _pixelSizeX, _pixelSizeY;
+	enum FitsIOChecker::Projection _projection;
+	double _phaseCentreDec, _phaseCentreDL, _phaseCentreDM;
+	BeamKernel _kernel;
+	BeamModel _model;
+	size_t _nThreads;
+	double _lookupTolerance;
+	size_t _coarseStep;
+	double _coarseTolerance;
+	std::string _cacheDirectory;
+	std::ostream* _log;
+	
+	bool _symmetric;
+	size_t _computeWidth, _computeHeight;
+	double _maxAngle, _maxRadius;
+	ao::uvector<double> _lValues;
+	
+	bool _distancesPrepared;
+	size_t _nGenerated;
+	Image _distanceMap;
+	std::unique_ptr<class DistanceMapCache> _distanceCache;
+	std::vector<ao::uvector<double>> _distanceRows, _beamRows;
+};
+
+#endif
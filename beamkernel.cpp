@@ -0,0 +1,87 @@
+#include "beamkernel.h"
+
+#include <cmath>
+
+namespace {
+	/**
+	 * Replaces the values in [0, 1] by factor * asin(value). std::asin() is a
+	 * library call that keeps the loop from being vectorized, so this uses the
+	 * rational approximation of fdlibm's asin(), with selects instead of its
+	 * branches. It is accurate to a few ulp. Values above 1 give NaN.
+	 */
+	void asinRow(double* __restrict__ values, size_t n, double factor)
+	{
+		const double
+			pS0 =  1.66666666666666657415e-01,
+			pS1 = -3.25565818622400915405e-01,
+			pS2 =  2.01212532134862925881e-01,
+			pS3 = -4.00555345006794114027e-02,
+			pS4 =  7.91534994289814532176e-04,
+			pS5 =  3.47933107596021167570e-05,
+			qS1 = -2.40339491173441421878e+00,
+			qS2 =  2.02094576023350569471e+00,
+			qS3 = -6.88283971605453293030e-01,
+			qS4 =  7.70381505559019352791e-02,
+			halfPi = M_PI * 0.5;
+		for(size_t i=0; i!=n; ++i)
+		{
+			const double x = values[i];
+			// For x > 0.5, asin(x) = pi/2 - 2 asin(sqrt((1-x)/2))
+			const bool isSmall = x <= 0.5;
+			const double
+				z = isSmall ? x*x : (1.0 - x) * 0.5,
+				s = isSmall ? x : std::sqrt(z),
+				p = z*(pS0+z*(pS1+z*(pS2+z*(pS3+z*(pS4+z*pS5))))),
+				q = 1.0+z*(qS1+z*(qS2+z*(qS3+z*qS4))),
+				asinS = s + s*(p/q);
+			values[i] = factor * (isSmall ? asinS : halfPi - 2.0*asinS);
+		}
+	}
+}
+
+BeamKernel::BeamKernel(enum FitsIOChecker::Projection projection, double phaseCentreDec, double phaseCentreDL, double phaseCentreDM) :
+	_projection(projection),
+	_sinDec0(std::sin(phaseCentreDec)),
+	_cosDec0(std::cos(phaseCentreDec)),
+	_phaseCentreDL(phaseCentreDL),
+	_phaseCentreDM(phaseCentreDM)
+{
+}
+
+void BeamKernel::DistanceRow(const double* __restrict__ l, double m, double* __restrict__ distance, size_t n) const
+{
+	// Same calculations as ImageCoordinates::LMToPhaseCentreDistance() and
+	// NCPProjection::LMToPhaseCentreDistance(), split in a pass that calculates
+	// the sine of the distance (or half the chord) and a pass for the asin.
+	const double
+		dl = _phaseCentreDL,
+		mShifted = m + _phaseCentreDM;
+	if(_projection == FitsIOChecker::SINProjection)
+	{
+		const double mSquared = mShifted * mShifted;
+		for(size_t i=0; i!=n; ++i)
+		{
+			const double lShifted = l[i] + dl;
+			distance[i] = std::sqrt(lShifted*lShifted + mSquared);
+		}
+		asinRow(distance, n, 1.0);
+	}
+	else {
+		const double
+			sinDec0 = _sinDec0,
+			cosDecCosDeltaAlpha = _cosDec0 - mShifted*sinDec0,
+			dx = mShifted*sinDec0,
+			cosTermSquared = cosDecCosDeltaAlpha*cosDecCosDeltaAlpha;
+		for(size_t i=0; i!=n; ++i)
+		{
+			const double
+				lShifted = l[i] + dl,
+				lSquared = lShifted*lShifted,
+				sinDecAbs = std::sqrt(1.0 - lSquared - cosTermSquared),
+				sinDec = sinDec0 < 0.0 ? -sinDecAbs : sinDecAbs,
+				dz = sinDec - sinDec0;
+			distance[i] = 0.5 * std::sqrt(dx*dx + lSquared + dz*dz);
+		}
+		asinRow(distance, n, 2.0);
+	}
+}
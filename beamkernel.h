@@ -0,0 +1,43 @@
+#ifndef BEAM_KERNEL_H
+#define BEAM_KERNEL_H
+
+#include "fitsiochecker.h"
+
+#include <cstddef>
+
+/**
+ * Calculates the angular distance to the phase centre for a full image row at
+ * a time, as input for the radial beam models in beammodel.h. Terms that only
+ * depend on the phase centre are calculated once on construction. The
+ * per-pixel work is split in a pass for the square roots and a pass for the
+ * asin, which uses a polynomial instead of std::asin(), such that the compiler
+ * can vectorize both loops (check with -fopt-info-vec; -march=native in
+ * CMakeLists.txt gives the wide instruction sets, a PORTABLE build uses SSE2).
+ * The distances agree with ImageCoordinates::LMToPhaseCentreDistance() and
+ * NCPProjection::LMToPhaseCentreDistance() to a few ulp.
+ */
+class BeamKernel
+{
+public:
+	/**
+	 * @param phaseCentreDL Shift of the image centre from the phase centre, as
+	 * given by FitsReader::PhaseCentreDL(). Same for @p phaseCentreDM.
+	 */
+	BeamKernel(enum FitsIOChecker::Projection projection, double phaseCentreDec, double phaseCentreDL, double phaseCentreDM);
+	
+	/**
+	 * Calculate the angular distance to the phase centre for one image row.
+	 * @param l l-coordinates of the pixels in the row, relative to the image centre.
+	 * @param m m-coordinate of the row, which is the same for all its pixels.
+	 * @param distance Output, the angular distance in radians.
+	 * @param n Number of pixels in the row.
+	 */
+	void DistanceRow(const double* l, double m, double* distance, size_t n) const;
+	
+private:
+	enum FitsIOChecker::Projection _projection;
+	double _sinDec0, _cosDec0;
+	double _phaseCentreDL, _phaseCentreDM;
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "beammodel.h"
+
+#include <sstream>
+#include <stdexcept>
+
+constexpr double GaussianBeamModel::SpeedOfLight;
+constexpr size_t PolynomialBeamModel::MaxCoefficients;
+
+BeamModel::Type BeamModel::ParseType(const std::string& name)
+{
+	if(name == "wsrt")
+		return WSRT;
+	else if(name == "gaussian")
+		return Gaussian;
+	else if(name == "airy")
+		return Airy;
+	else if(name == "polynomial")
+		return Polynomial;
+	else
+		throw std::runtime_error("Unknown beam model: " + name);
+}
+
+std::string BeamModel::TypeName(Type type)
+{
+	switch(type)
+	{
+		case WSRT: return "wsrt";
+		case Gaussian: return "gaussian";
+		case Airy: return "airy";
+		case Polynomial: return "polynomial";
+	}
+	return std::string();
+}
+
+std::vector<double> BeamModel::ParseCoefficients(const std::string& str)
+{
+	std::vector<double> coefficients;
+	std::istringstream stream(str);
+	std::string item;
+	while(std::getline(stream, item, ','))
+	{
+		std::istringstream itemStream(item);
+		double value;
+		if(!(itemStream >> value))
+			throw std::runtime_error("Could not parse polynomial coefficients: " + str);
+		coefficients.push_back(value);
+	}
+	if(coefficients.size() > PolynomialBeamModel::MaxCoefficients)
+		throw std::runtime_error("Too many polynomial coefficients");
+	return coefficients;
+}
+
+template<typename Model>
+void BeamModel::evaluateRow(const Model& model, const double* __restrict__ distance, double* __restrict__ beam, size_t n)
+{
+	for(size_t i=0; i!=n; ++i)
+		beam[i] = model(distance[i]);
+}
+
+void BeamModel::EvaluateRow(double frequencyHz, const double* distance, double* beam, size_t n) const
+{
+	switch(_type)
+	{
+		case WSRT:
+			evaluateRow(WSRTBeamModel(frequencyHz), distance, beam, n);
+			break;
+		case Gaussian:
+			evaluateRow(GaussianBeamModel(frequencyHz, _dishDiameter), distance, beam, n);
+			break;
+		case Airy:
+			evaluateRow(AiryBeamModel(frequencyHz, _dishDiameter), distance, beam, n);
+			break;
+		case Polynomial:
+			evaluateRow(PolynomialBeamModel(frequencyHz, _coefficients), distance, beam, n);
+			break;
+	}
+}
+
+std::function<double(double)> BeamModel::Evaluator(double frequencyHz) const
+{
+	switch(_type)
+	{
+		case WSRT:
+			return WSRTBeamModel(frequencyHz);
+		case Gaussian:
+			return GaussianBeamModel(frequencyHz, _dishDiameter);
+		case Airy:
+			return AiryBeamModel(frequencyHz, _dishDiameter);
+		case Polynomial:
+			return PolynomialBeamModel(frequencyHz, _coefficients);
+	}
+	throw std::runtime_error("Invalid beam model");
+}
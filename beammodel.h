@@ -0,0 +1,205 @@
+#ifndef BEAM_MODEL_H
+#define BEAM_MODEL_H
+
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Simple Westerbork beam: pb = cos^6(beta*freq(MHz)*angle).
+ */
+class WSRTBeamModel
+{
+public:
+	explicit WSRTBeamModel(double frequencyHz)
+	{
+		const double freqMHz = frequencyHz * 1e-6;
+		_betaFreqMHz = Beta(freqMHz) * freqMHz;
+	}
+	
+	/**
+	 * The beta factor: 0.0629 for f < 500 MHz, and 0.065 for f > 500 MHz.
+	 * In the original equation the angle is in degrees, but beta is used with the angle in
+	 * radians; since the cosine is in degrees too, no conversion is needed.
+	 */
+	static double Beta(double freqMHz)
+	{
+		return freqMHz < 500 ? 0.0629 : 0.065;
+	}
+	
+	double operator()(double distance) const
+	{
+		const double
+			cosTerm = std::cos(_betaFreqMHz*distance),
+			cosTerm2 = cosTerm*cosTerm;
+		return cosTerm2*cosTerm2*cosTerm2;
+	}
+	
+private:
+	double _betaFreqMHz;
+};
+
+/**
+ * Gaussian beam of a dish with the given diameter, with FWHM = 1.02 lambda / D, which
+ * approximates the main lobe of a uniformly illuminated dish.
+ */
+class GaussianBeamModel
+{
+public:
+	GaussianBeamModel(double frequencyHz, double dishDiameter)
+	{
+		const double fwhm = 1.02 * (SpeedOfLight / frequencyHz) / dishDiameter;
+		_factor = -4.0 * M_LN2 / (fwhm * fwhm);
+	}
+	
+	double operator()(double distance) const
+	{
+		return std::exp(_factor * distance * distance);
+	}
+	
+	static constexpr double SpeedOfLight = 299792458.0;
+	
+private:
+	double _factor;
+};
+
+/**
+ * Airy disk of a uniformly illuminated dish: pb = (2 J1(x) / x)^2, with
+ * x = pi D sin(angle) / lambda.
+ */
+class AiryBeamModel
+{
+public:
+	AiryBeamModel(double frequencyHz, double dishDiameter) :
+		_factor(M_PI * dishDiameter * frequencyHz / GaussianBeamModel::SpeedOfLight)
+	{ }
+	
+	double operator()(double distance) const
+	{
+		const double x = _factor * std::sin(distance);
+		if(std::fabs(x) < 1e-8)
+			return 1.0;
+		const double amplitude = 2.0 * j1(x) / x;
+		return amplitude * amplitude;
+	}
+	
+private:
+	double _factor;
+};
+
+/**
+ * Polynomial beam as used by AIPS PBCOR for the VLA:
+ * pb = 1 + G1 x + G2 x^2 + G3 x^3 + ..., with x = (angle(arcmin) * freq(GHz))^2.
+ */
+class PolynomialBeamModel
+{
+public:
+	static constexpr size_t MaxCoefficients = 8;
+	
+	PolynomialBeamModel(double frequencyHz, const std::vector<double>& coefficients) :
+		_nCoefficients(coefficients.size())
+	{
+		if(_nCoefficients > MaxCoefficients)
+			_nCoefficients = MaxCoefficients;
+		for(size_t i=0; i!=_nCoefficients; ++i)
+			_coefficients[i] = coefficients[i];
+		_factor = (180.0 * 60.0 / M_PI) * frequencyHz * 1e-9;
+	}
+	
+	double operator()(double distance) const
+	{
+		const double
+			scaled = _factor * distance,
+			x = scaled * scaled;
+		double sum = 0.0;
+		for(size_t i=_nCoefficients; i!=0; --i)
+			sum = (sum + _coefficients[i-1]) * x;
+		return 1.0 + sum;
+	}
+	
+private:
+	double _coefficients[MaxCoefficients];
+	size_t _nCoefficients;
+	double _factor;
+};
+
+/**
+ * Selects one of the beam models above and evaluates it. The models only depend
+ * on the angular distance to the pointing centre. The row function switches
+ * on the model once and then runs a loop that is instantiated for that model,
+ * so that the model is inlined in the per-pixel loop without any dispatch.
+ */
+class BeamModel
+{
+public:
+	enum Type { WSRT, Gaussian, Airy, Polynomial };
+	
+	BeamModel() :
+		_type(WSRT),
+		_dishDiameter(25.0),
+		// AIPS PBCOR defaults for the VLA
+		_coefficients{ -1.343e-3, 6.579e-7, -1.186e-10 }
+	{ }
+	
+	/**
+	 * Convert a name ("wsrt", "gaussian", "airy" or "polynomial") to a model type.
+	 */
+	static Type ParseType(const std::string& name);
+	
+	static std::string TypeName(Type type);
+	
+	/**
+	 * Parse a comma-separated list of polynomial coefficients.
+	 */
+	static std::vector<double> ParseCoefficients(const std::string& str);
+	
+	Type GetType() const { return _type; }
+	void SetType(Type type) { _type = type; }
+	
+	/** Dish diameter in meters, used by the Gaussian and Airy models. Default: 25 m. */
+	double DishDiameter() const { return _dishDiameter; }
+	void SetDishDiameter(double dishDiameter) { _dishDiameter = dishDiameter; }
+	
+	/** Coefficients G1, G2, ... of the polynomial model. Default: VLA values from PBCOR. */
+	const std::vector<double>& Coefficients() const { return _coefficients; }
+	void SetCoefficients(const std::vector<double>& coefficients) { _coefficients = coefficients; }
+	
+	/**
+	 * Evaluate the beam for a row of distances.
+	 * @param distance Angular distances to the pointing centre in radians.
+	 * @param beam Output beam values.
+	 */
+	void EvaluateRow(double frequencyHz, const double* distance, double* beam, size_t n) const;
+	
+	/**
+	 * The beam at one frequency as a function of the distance. The model is
+	 * selected and set up once, so this is the way to evaluate single distances
+	 * many times, e.g. for the nodes of a coarse grid or to fill a
+	 * RadialLookupTable.
+	 */
+	std::function<double(double distance)> Evaluator(double frequencyHz) const;
+	
+	/**
+	 * Evaluate the beam for a single distance. This dispatches on every call, so
+	 * should not be used in a per-pixel loop; use Evaluator() or EvaluateRow()
+	 * instead.
+	 */
+	double Evaluate(double frequencyHz, double distance) const
+	{
+		double value;
+		EvaluateRow(frequencyHz, &distance, &value, 1);
+		return value;
+	}
+	
+private:
+	template<typename Model>
+	static void evaluateRow(const Model& model, const double* distance, double* beam, size_t n);
+	
+	Type _type;
+	double _dishDiameter;
+	std::vector<double> _coefficients;
+};
+
+#endif
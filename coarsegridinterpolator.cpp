@@ -0,0 +1,154 @@
+#include "coarsegridinterpolator.h"
+
+#include "parallelfor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <stdexcept>
+
+CoarseGridInterpolator::CoarseGridInterpolator(size_t step, double tolerance) :
+	_step(step),
+	_tolerance(tolerance),
+	_weights(step),
+	_maxError(0.0),
+	_nRefinedCells(0),
+	_nCells(0)
+{
+	if(step == 0)
+		throw std::runtime_error("Coarse grid step should be at least one pixel");
+	for(size_t i=0; i!=step; ++i)
+		_weights[i] = cubicWeights(double(i) / step);
+}
+
+/**
+ * Four-point Lagrange weights for the nodes at -1, 0, 1 and 2, for a position t
+ * between nodes 0 and 1. This reproduces cubic polynomials exactly, which makes it
+ * considerably more accurate for a smooth beam than e.g. Catmull-Rom weights.
+ */
+CoarseGridInterpolator::Weights CoarseGridInterpolator::cubicWeights(double t)
+{
+	Weights weights;
+	weights.w[0] = -t * (t-1.0) * (t-2.0) / 6.0;
+	weights.w[1] = (t+1.0) * (t-1.0) * (t-2.0) / 2.0;
+	weights.w[2] = -(t+1.0) * t * (t-2.0) / 2.0;
+	weights.w[3] = (t+1.0) * t * (t-1.0) / 6.0;
+	return weights;
+}
+
+template<typename NumType>
+void CoarseGridInterpolator::Fill(NumType* image, size_t width, size_t height, size_t stride, const std::function<double(double x, double y)>& evaluate, size_t nThreads)
+{
+	// Node i lies at pixel (i-1)*step, so every cell has a node before and
+	// after it in both directions, as required for cubic interpolation.
+	const size_t
+		nCellsX = (width + _step - 1) / _step,
+		nCellsY = (height + _step - 1) / _step,
+		nNodesX = nCellsX + 3,
+		nNodesY = nCellsY + 3;
+	ao::uvector<double> nodes(nNodesX * nNodesY);
+	ParallelFor loop(nThreads);
+	loop.Run(0, nNodesY, [&](size_t ny, size_t)
+	{
+		const double y = (double(ny) - 1.0) * _step;
+		for(size_t nx=0; nx!=nNodesX; ++nx)
+			nodes[ny*nNodesX + nx] = evaluate((double(nx) - 1.0) * _step, y);
+	});
+	
+	_maxError = 0.0;
+	_nRefinedCells = 0;
+	_nCells = nCellsX * nCellsY;
+	std::mutex mutex;
+	loop.Run(0, nCellsY, [&](size_t cy, size_t)
+	{
+		double maxError = 0.0;
+		size_t nRefined = 0;
+		const size_t
+			yStart = cy * _step,
+			yEnd = std::min(yStart + _step, height);
+		for(size_t cx=0; cx!=nCellsX; ++cx)
+		{
+			const size_t
+				xStart = cx * _step,
+				xEnd = std::min(xStart + _step, width);
+			// 4x4 neighbourhood of nodes, starting one node before the cell
+			const double* cellNodes = &nodes[cy*nNodesX + cx];
+			
+			auto interpolate = [&](const Weights& wx, const Weights& wy) -> double
+			{
+				double value = 0.0;
+				for(size_t j=0; j!=4; ++j)
+				{
+					const double* nodeRow = &cellNodes[j*nNodesX];
+					value += wy.w[j] * (wx.w[0]*nodeRow[0] + wx.w[1]*nodeRow[1] + wx.w[2]*nodeRow[2] + wx.w[3]*nodeRow[3]);
+				}
+				return value;
+			};
+			
+			bool refine = false;
+			for(size_t j=0; j!=4 && !refine; ++j)
+			{
+				for(size_t i=0; i!=4; ++i)
+					refine = refine || !std::isfinite(cellNodes[j*nNodesX + i]);
+			}
+			
+			double cellError = 0.0;
+			if(!refine)
+			{
+				// Test the centre of the cell and the centres of its edges. The edges are
+				// shared with the neighbouring cells, but a neighbour might be refined
+				// while this cell is not, so each cell tests all four of them.
+				const double testPoints[5][2] = { { 0.5, 0.5 }, { 0.0, 0.5 }, { 1.0, 0.5 }, { 0.5, 0.0 }, { 0.5, 1.0 } };
+				for(const double* t : testPoints)
+				{
+					const double
+						exact = evaluate(xStart + t[0]*_step, yStart + t[1]*_step),
+						error = std::fabs(interpolate(cubicWeights(t[0]), cubicWeights(t[1])) - exact);
+					if(!(error <= _tolerance))
+					{
+						refine = true;
+						break;
+					}
+					cellError = std::max(cellError, error);
+				}
+			}
+			
+			if(refine)
+			{
+				++nRefined;
+				for(size_t y=yStart; y!=yEnd; ++y)
+				{
+					for(size_t x=xStart; x!=xEnd; ++x)
+						image[y*stride + x] = evaluate(x, y);
+				}
+			}
+			else {
+				maxError = std::max(maxError, cellError);
+				for(size_t y=yStart; y!=yEnd; ++y)
+				{
+					const Weights& wy = _weights[y - yStart];
+					// Interpolate the four node columns in y once for this pixel row
+					double columns[4];
+					for(size_t i=0; i!=4; ++i)
+					{
+						columns[i] =
+							wy.w[0]*cellNodes[i] + wy.w[1]*cellNodes[nNodesX + i] +
+							wy.w[2]*cellNodes[2*nNodesX + i] + wy.w[3]*cellNodes[3*nNodesX + i];
+					}
+					NumType* row = &image[y*stride];
+					for(size_t x=xStart; x!=xEnd; ++x)
+					{
+						const Weights& wx = _weights[x - xStart];
+						row[x] = wx.w[0]*columns[0] + wx.w[1]*columns[1] + wx.w[2]*columns[2] + wx.w[3]*columns[3];
+					}
+				}
+			}
+		}
+		std::lock_guard<std::mutex> lock(mutex);
+		_maxError = std::max(_maxError, maxError);
+		_nRefinedCells += nRefined;
+	});
+}
+
+template void CoarseGridInterpolator::Fill(double* image, size_t width, size_t height, size_t stride, const std::function<double(double x, double y)>& evaluate, size_t nThreads);
+template void CoarseGridInterpolator::Fill(float* image, size_t width, size_t height, size_t stride, const std::function<double(double x, double y)>& evaluate, size_t nThreads);
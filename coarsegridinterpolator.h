@@ -0,0 +1,62 @@
+#ifndef COARSE_GRID_INTERPOLATOR_H
+#define COARSE_GRID_INTERPOLATOR_H
+
+#include "uvector.h"
+
+#include <cstddef>
+#include <functional>
+
+/**
+ * Fills an image with a smooth function by evaluating the function exactly
+ * on a coarse grid of nodes, and interpolating the pixels in between with
+ * separable bicubic (four-point Lagrange) interpolation. In each cell of the grid, the
+ * interpolation is compared with the exact function at a few test points; when
+ * the error is larger than the tolerance, or when one of the nodes is not
+ * finite, all pixels of that cell are evaluated exactly.
+ */
+class CoarseGridInterpolator
+{
+public:
+	/**
+	 * @param step Distance in pixels between two nodes of the coarse grid.
+	 * @param tolerance Maximum allowed absolute error at the test points.
+	 */
+	CoarseGridInterpolator(size_t step, double tolerance);
+	
+	/**
+	 * Fill the image.
+	 * @param image Output image of size width x height.
+	 * @param stride Distance between the start of two rows in the image, which
+	 * allows filling a part of a larger image.
+	 * @param evaluate The function to interpolate. It is called with pixel
+	 * coordinates, which can be fractional and can lie up to one step outside
+	 * the image, and might be called from multiple threads simultaneously.
+	 * @param nThreads Number of threads to use.
+	 * The function is evaluated and interpolated in double precision; the
+	 * image can be float or double.
+	 */
+	template<typename NumType>
+	void Fill(NumType* image, size_t width, size_t height, size_t stride, const std::function<double(double x, double y)>& evaluate, size_t nThreads);
+	
+	/** Largest error measured at the test points of the interpolated cells during the last Fill(). */
+	double MaxError() const { return _maxError; }
+	
+	/** Number of cells that were evaluated exactly during the last Fill(). */
+	size_t NRefinedCells() const { return _nRefinedCells; }
+	
+	/** Total number of cells in the last Fill(). */
+	size_t NCells() const { return _nCells; }
+	
+private:
+	struct Weights { double w[4]; };
+	
+	static Weights cubicWeights(double t);
+	
+	size_t _step;
+	double _tolerance;
+	ao::uvector<Weights> _weights;
+	double _maxError;
+	size_t _nRefinedCells, _nCells;
+};
+
+#endif
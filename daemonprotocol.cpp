@@ -0,0 +1,186 @@
+#include "daemonprotocol.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace {
+	void writeAll(int fd, const char* data, size_t size)
+	{
+		while(size != 0)
+		{
+			ssize_t n = write(fd, data, size);
+			if(n < 0)
+			{
+				if(errno == EINTR)
+					continue;
+				throw std::runtime_error(std::string("Could not write to socket: ") + strerror(errno));
+			}
+			data += n;
+			size -= n;
+		}
+	}
+	
+	/**
+	 * @returns false when the connection was closed before the first byte.
+	 */
+	bool readAll(int fd, char* data, size_t size)
+	{
+		size_t nRead = 0;
+		while(nRead != size)
+		{
+			ssize_t n = read(fd, data + nRead, size - nRead);
+			if(n < 0)
+			{
+				if(errno == EINTR)
+					continue;
+				if(errno == EAGAIN || errno == EWOULDBLOCK)
+					throw std::runtime_error("Timed out while reading from socket");
+				throw std::runtime_error(std::string("Could not read from socket: ") + strerror(errno));
+			}
+			if(n == 0)
+			{
+				if(nRead == 0)
+					return false;
+				throw std::runtime_error("Connection closed in the middle of a message");
+			}
+			nRead += n;
+		}
+		return true;
+	}
+}
+
+std::string DaemonProtocol::DefaultSocketPath()
+{
+	const char* path = getenv("APERTOOLSD_SOCKET");
+	if(path != nullptr && *path != 0)
+		return path;
+	const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+	if(runtimeDir != nullptr && *runtimeDir != 0)
+		return std::string(runtimeDir) + "/apertoolsd.socket";
+	return "/tmp/apertoolsd-" + std::to_string(getuid()) + ".socket";
+}
+
+uid_t DaemonProtocol::PeerUid(int fd)
+{
+#ifdef SO_PEERCRED
+	ucred credentials;
+	socklen_t length = sizeof(credentials);
+	if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0)
+		throw std::runtime_error(std::string("Could not get the owner of the socket peer: ") + strerror(errno));
+	return credentials.uid;
+#else
+	uid_t uid;
+	gid_t gid;
+	if(getpeereid(fd, &uid, &gid) != 0)
+		throw std::runtime_error(std::string("Could not get the owner of the socket peer: ") + strerror(errno));
+	return uid;
+#endif
+}
+
+void DaemonProtocol::WriteMessage(int fd, MessageType type, const std::string& payload)
+{
+	const size_t size = payload.size() + 1;
+	if(size > MaxMessageSize)
+		throw std::runtime_error("Message too large");
+	unsigned char header[5] = {
+		(unsigned char)(size >> 24), (unsigned char)(size >> 16),
+		(unsigned char)(size >> 8), (unsigned char)(size),
+		(unsigned char)(type)
+	};
+	writeAll(fd, reinterpret_cast<const char*>(header), sizeof(header));
+	writeAll(fd, payload.data(), payload.size());
+}
+
+bool DaemonProtocol::ReadMessage(int fd, MessageType& type, std::string& payload)
+{
+	unsigned char header[5];
+	if(!readAll(fd, reinterpret_cast<char*>(header), 4))
+		return false;
+	const size_t size =
+		(size_t(header[0]) << 24) | (size_t(header[1]) << 16) |
+		(size_t(header[2]) << 8) | size_t(header[3]);
+	if(size == 0 || size > MaxMessageSize)
+		throw std::runtime_error("Invalid message size");
+	if(!readAll(fd, reinterpret_cast<char*>(&header[4]), 1))
+		throw std::runtime_error("Connection closed in the middle of a message");
+	type = MessageType(header[4]);
+	payload.resize(size - 1);
+	if(size != 1 && !readAll(fd, &payload[0], size - 1))
+		throw std::runtime_error("Connection closed in the middle of a message");
+	return true;
+}
+
+std::string DaemonProtocol::MakeJob(const std::string& workingDirectory, const std::vector<std::string>& arguments)
+{
+	std::string payload = workingDirectory;
+	payload += '\0';
+	for(const std::string& argument : arguments)
+	{
+		payload += argument;
+		payload += '\0';
+	}
+	return payload;
+}
+
+void DaemonProtocol::ParseJob(const std::string& payload, std::string& workingDirectory, std::vector<std::string>& arguments)
+{
+	std::vector<std::string> strings;
+	size_t start = 0;
+	while(start != payload.size())
+	{
+		size_t end = payload.find('\0', start);
+		if(end == std::string::npos)
+			throw std::runtime_error("Invalid job message");
+		strings.emplace_back(payload, start, end - start);
+		start = end + 1;
+	}
+	// The working directory and at least the tool name
+	if(strings.size() < 2)
+		throw std::runtime_error("Invalid job message");
+	workingDirectory = strings.front();
+	arguments.assign(strings.begin() + 1, strings.end());
+}
+
+DaemonMessageBuffer::int_type DaemonMessageBuffer::overflow(int_type c)
+{
+	if(traits_type::eq_int_type(c, traits_type::eof()))
+		return traits_type::not_eof(c);
+	const char ch = traits_type::to_char_type(c);
+	return xsputn(&ch, 1) == 1 ? c : traits_type::eof();
+}
+
+std::streamsize DaemonMessageBuffer::xsputn(const char* data, std::streamsize n)
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_pending.append(data, n);
+	if(_pending.find('\n') != std::string::npos && !sendPending())
+		return 0;
+	return n;
+}
+
+int DaemonMessageBuffer::sync()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	return sendPending() ? 0 : -1;
+}
+
+bool DaemonMessageBuffer::sendPending()
+{
+	if(!_pending.empty() && !_failed)
+	{
+		try {
+			DaemonProtocol::WriteMessage(_fd, _type, _pending);
+		} catch(std::exception&) {
+			// The client went away; the job still runs to completion
+			_failed = true;
+		}
+	}
+	_pending.clear();
+	return !_failed;
+}
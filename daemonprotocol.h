@@ -0,0 +1,90 @@
+#ifndef DAEMON_PROTOCOL_H
+#define DAEMON_PROTOCOL_H
+
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+/**
+ * The protocol between apertoolsd and apclient over a Unix domain socket.
+ * Every message is a 4-byte big-endian length, followed by that many bytes:
+ * a type character and the payload. The client sends one Job message, with
+ * the working directory, the tool name and the arguments, each terminated
+ * by a zero byte. The daemon answers with any number of Output and Error
+ * messages, which hold text that the tool writes, and finally one Status
+ * message with the exit status in decimal, after which it closes the
+ * connection.
+ */
+class DaemonProtocol
+{
+public:
+	enum MessageType {
+		JobMessage = 'J',
+		OutputMessage = 'O',
+		ErrorMessage = 'E',
+		StatusMessage = 'S'
+	};
+	
+	/** Messages larger than this are refused. */
+	static constexpr size_t MaxMessageSize = 16*1024*1024;
+	
+	/**
+	 * Socket of the daemon: $APERTOOLSD_SOCKET if set, otherwise
+	 * apertoolsd.socket in $XDG_RUNTIME_DIR, or /tmp/apertoolsd-<uid>.socket.
+	 */
+	static std::string DefaultSocketPath();
+	
+	/**
+	 * Time that the daemon waits for the job after a client connects.
+	 */
+	static constexpr int JobTimeoutSeconds = 10;
+	
+	/**
+	 * User id of the process at the other end of a connected Unix socket.
+	 */
+	static uid_t PeerUid(int fd);
+	
+	static void WriteMessage(int fd, MessageType type, const std::string& payload);
+	
+	/**
+	 * @returns false when the connection was closed before a message started.
+	 */
+	static bool ReadMessage(int fd, MessageType& type, std::string& payload);
+	
+	static std::string MakeJob(const std::string& workingDirectory, const std::vector<std::string>& arguments);
+	static void ParseJob(const std::string& payload, std::string& workingDirectory, std::vector<std::string>& arguments);
+};
+
+/**
+ * Stream buffer that sends everything written to it as messages of one type.
+ * It can be written from several threads; text is sent when a line is
+ * complete or when the stream is flushed.
+ */
+class DaemonMessageBuffer : public std::streambuf
+{
+public:
+	DaemonMessageBuffer(int fd, DaemonProtocol::MessageType type) :
+		_fd(fd), _type(type), _failed(false)
+	{ }
+	
+	~DaemonMessageBuffer() { sendPending(); }
+	
+protected:
+	int_type overflow(int_type c) override;
+	std::streamsize xsputn(const char* data, std::streamsize n) override;
+	int sync() override;
+	
+private:
+	bool sendPending();
+	
+	int _fd;
+	DaemonProtocol::MessageType _type;
+	bool _failed;
+	std::string _pending;
+	std::mutex _mutex;
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "distancemapcache.h"
+
+#include "fitsreader.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	// FNV-1a
+	void hashBytes(uint64_t& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for(size_t i=0; i!=size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001b3ull;
+		}
+	}
+	
+	template<typename T>
+	void appendToHeader(char*& position, const T& value)
+	{
+		memcpy(position, &value, sizeof(T));
+		position += sizeof(T);
+	}
+}
+
+DistanceMapCache::DistanceMapCache(const std::string& directory, const FitsReader& reader) :
+	DistanceMapCache(directory, reader.ImageWidth(), reader.ImageHeight(),
+		reader.PixelSizeX(), reader.PixelSizeY(), reader.ProjectionType(),
+		reader.PhaseCentreDec(), reader.PhaseCentreDL(), reader.PhaseCentreDM())
+{
+}
+
+DistanceMapCache::DistanceMapCache(const std::string& directory, size_t width, size_t height,
+	double pixelSizeX, double pixelSizeY, enum FitsIOChecker::Projection projection,
+	double phaseCentreDec, double phaseCentreDL, double phaseCentreDM) :
+	_projection(projection),
+	_width(width),
+	_height(height),
+	_pixelSizeX(pixelSizeX),
+	_pixelSizeY(pixelSizeY),
+	_phaseCentreDec(phaseCentreDec),
+	_phaseCentreDL(phaseCentreDL),
+	_phaseCentreDM(phaseCentreDM),
+	_mapping(nullptr),
+	_mappingSize(0),
+	_data(nullptr)
+{
+	if(mkdir(directory.c_str(), 0777) != 0 && errno != EEXIST)
+		throw std::runtime_error("Could not create distance map cache directory " + directory + ": " + strerror(errno));
+	
+	// The fields are hashed one by one to avoid hashing struct padding. The RA of the
+	// phase centre does not change the distances, so is not part of the key.
+	uint64_t hash = 0xcbf29ce484222325ull;
+	hashBytes(hash, &_projection, sizeof(_projection));
+	hashBytes(hash, &_width, sizeof(_width));
+	hashBytes(hash, &_height, sizeof(_height));
+	hashBytes(hash, &_pixelSizeX, sizeof(_pixelSizeX));
+	hashBytes(hash, &_pixelSizeY, sizeof(_pixelSizeY));
+	hashBytes(hash, &_phaseCentreDec, sizeof(_phaseCentreDec));
+	hashBytes(hash, &_phaseCentreDL, sizeof(_phaseCentreDL));
+	hashBytes(hash, &_phaseCentreDM, sizeof(_phaseCentreDM));
+	std::ostringstream name;
+	name << directory << "/distance-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".map";
+	_filename = name.str();
+}
+
+DistanceMapCache::~DistanceMapCache()
+{
+	unmap();
+}
+
+void DistanceMapCache::unmap()
+{
+	if(_mapping != nullptr)
+	{
+		munmap(_mapping, _mappingSize);
+		_mapping = nullptr;
+		_mappingSize = 0;
+		_data = nullptr;
+	}
+}
+
+/**
+ * The header repeats the full key, so that a hash collision is detected.
+ * It is written in native byte order, as the cache is meant for the local machine.
+ */
+void DistanceMapCache::makeHeader(char* header, size_t mapWidth, size_t mapHeight) const
+{
+	memset(header, 0, HeaderSize);
+	char* position = header;
+	memcpy(position, "APDMAP01", 8);
+	position += 8;
+	appendToHeader(position, _projection);
+	appendToHeader(position, _width);
+	appendToHeader(position, _height);
+	appendToHeader(position, uint64_t(mapWidth));
+	appendToHeader(position, uint64_t(mapHeight));
+	appendToHeader(position, _pixelSizeX);
+	appendToHeader(position, _pixelSizeY);
+	appendToHeader(position, _phaseCentreDec);
+	appendToHeader(position, _phaseCentreDL);
+	appendToHeader(position, _phaseCentreDM);
+}
+
+bool DistanceMapCache::Open(size_t mapWidth, size_t mapHeight)
+{
+	unmap();
+	int fd = open(_filename.c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	const size_t expectedSize = HeaderSize + mapWidth * mapHeight * sizeof(float);
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) != 0 || size_t(fileStat.st_size) != expectedSize)
+	{
+		close(fd);
+		return false;
+	}
+	void* mapping = mmap(nullptr, expectedSize, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED)
+		return false;
+	
+	char header[HeaderSize];
+	makeHeader(header, mapWidth, mapHeight);
+	if(memcmp(mapping, header, HeaderSize) != 0)
+	{
+		munmap(mapping, expectedSize);
+		return false;
+	}
+	_mapping = mapping;
+	_mappingSize = expectedSize;
+	_data = reinterpret_cast<const float*>(static_cast<const char*>(mapping) + HeaderSize);
+	return true;
+}
+
+void DistanceMapCache::Store(const float* map, size_t mapWidth, size_t mapHeight)
+{
+	unmap();
+	std::ostringstream tmpName;
+	tmpName << _filename << ".tmp" << getpid();
+	{
+		std::ofstream file(tmpName.str(), std::ios::binary);
+		char header[HeaderSize];
+		makeHeader(header, mapWidth, mapHeight);
+		file.write(header, HeaderSize);
+		file.write(reinterpret_cast<const char*>(map), mapWidth * mapHeight * sizeof(float));
+		// Closing flushes the last part, which can fail as well, e.g. on a full disk
+		file.close();
+		if(!file)
+		{
+			std::remove(tmpName.str().c_str());
+			throw std::runtime_error("Could not write distance map cache file " + tmpName.str());
+		}
+	}
+	if(std::rename(tmpName.str().c_str(), _filename.c_str()) != 0)
+	{
+		std::remove(tmpName.str().c_str());
+		throw std::runtime_error("Could not rename distance map cache file to " + _filename);
+	}
+	if(!Open(mapWidth, mapHeight))
+		throw std::runtime_error("Could not map distance map cache file " + _filename);
+}
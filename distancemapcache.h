@@ -0,0 +1,76 @@
+#ifndef DISTANCE_MAP_CACHE_H
+#define DISTANCE_MAP_CACHE_H
+
+#include "fitsiochecker.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * On-disk cache for maps of the angular distance to the phase centre. The
+ * distance map only depends on the image geometry (size, pixel scale, phase
+ * centre and projection), which is the same for many runs of apbeam with
+ * different frequencies. The map is stored as float32 in a file of which
+ * the name contains a hash of the geometry, and is memory mapped when it is
+ * reused.
+ */
+class DistanceMapCache
+{
+public:
+	/**
+	 * @param directory Directory that holds the cache files. It is created
+	 * if it does not exist.
+	 * @param reader Image of which the geometry is used as key.
+	 */
+	DistanceMapCache(const std::string& directory, const class FitsReader& reader);
+	
+	/**
+	 * Same as above, with the geometry given directly, for images that are not
+	 * read from a file. The parameters are as in FitsReader.
+	 */
+	DistanceMapCache(const std::string& directory, size_t width, size_t height,
+		double pixelSizeX, double pixelSizeY, enum FitsIOChecker::Projection projection,
+		double phaseCentreDec, double phaseCentreDL, double phaseCentreDM);
+	~DistanceMapCache();
+	
+	DistanceMapCache(const DistanceMapCache&) = delete;
+	DistanceMapCache& operator=(const DistanceMapCache&) = delete;
+	
+	/**
+	 * Map an existing cache file.
+	 * @param mapWidth Width of the map, which can be smaller than the image
+	 * when only a quadrant is stored. Same for @p mapHeight.
+	 * @returns false if there is no (valid) file for this geometry and map size.
+	 */
+	bool Open(size_t mapWidth, size_t mapHeight);
+	
+	/**
+	 * Write a map to the cache and map it. The file is written under a temporary
+	 * name and renamed afterwards, so concurrent runs never see a partial file.
+	 */
+	void Store(const float* map, size_t mapWidth, size_t mapHeight);
+	
+	/** The mapped distances, only valid after a successful Open() or Store(). */
+	const float* Data() const { return _data; }
+	
+	const std::string& Filename() const { return _filename; }
+	
+private:
+	// Size of the file header; the data starts at this offset
+	static constexpr size_t HeaderSize = 128;
+	
+	void makeHeader(char* header, size_t mapWidth, size_t mapHeight) const;
+	void unmap();
+	
+	uint32_t _projection;
+	uint64_t _width, _height;
+	double _pixelSizeX, _pixelSizeY;
+	double _phaseCentreDec, _phaseCentreDL, _phaseCentreDM;
+	std::string _filename;
+	void* _mapping;
+	size_t _mappingSize;
+	const float* _data;
+};
+
+#endif
@@ -0,0 +1,94 @@
+#include "fitsplaneiterator.h"
+
+#include "fitsreader.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+template<typename NumType>
+FitsPlaneIterator<NumType>::FitsPlaneIterator(FitsReader& reader, size_t depth) :
+	_reader(reader),
+	_planeSize(reader.ImageWidth() * reader.ImageHeight()),
+	_nPlanes(reader.NImages()),
+	_depth(std::max<size_t>(depth, 1)),
+	_buffers(std::min(_depth, _nPlanes)),
+	_current(0),
+	_nRead(0),
+	_stop(false)
+{
+	for(ao::uvector<NumType>& buffer : _buffers)
+		buffer.resize(_planeSize);
+	if(_nPlanes != 0)
+		_thread = std::thread(&FitsPlaneIterator<NumType>::readPlanes, this);
+}
+
+template<typename NumType>
+FitsPlaneIterator<NumType>::~FitsPlaneIterator()
+{
+	if(_thread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_stop = true;
+		}
+		_releaseCondition.notify_one();
+		_thread.join();
+	}
+}
+
+template<typename NumType>
+void FitsPlaneIterator<NumType>::readPlanes()
+{
+	for(size_t plane=0; plane!=_nPlanes; ++plane)
+	{
+		{
+			// Wait for the buffer of the plane that is _depth planes back to be released
+			std::unique_lock<std::mutex> lock(_mutex);
+			while(!_stop && plane >= _current + _depth)
+				_releaseCondition.wait(lock);
+			if(_stop)
+				return;
+		}
+		// The buffer is not used by the other thread, so it is filled without the lock
+		try {
+			_reader.ReadIndex(_buffers[plane % _depth].data(), plane);
+		} catch(...) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_exception = std::current_exception();
+			_readCondition.notify_one();
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_nRead = plane + 1;
+		}
+		_readCondition.notify_one();
+	}
+}
+
+template<typename NumType>
+NumType* FitsPlaneIterator<NumType>::Plane()
+{
+	// There is no plane to wait for after the last one
+	if(AtEnd())
+		throw std::runtime_error("FitsPlaneIterator::Plane() called after the last plane");
+	std::unique_lock<std::mutex> lock(_mutex);
+	while(_nRead <= _current && !_exception)
+		_readCondition.wait(lock);
+	if(_nRead <= _current)
+		std::rethrow_exception(_exception);
+	return _buffers[_current % _depth].data();
+}
+
+template<typename NumType>
+void FitsPlaneIterator<NumType>::Next()
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		++_current;
+	}
+	_releaseCondition.notify_one();
+}
+
+template class FitsPlaneIterator<float>;
+template class FitsPlaneIterator<double>;
@@ -0,0 +1,86 @@
+#ifndef FITS_PLANE_ITERATOR_H
+#define FITS_PLANE_ITERATOR_H
+
+#include "uvector.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Walks over the planes of an image cube, reading ahead on a background
+ * thread, so that processing plane k overlaps with reading the next planes.
+ * The planes are read into a ring of @p depth buffers that are allocated
+ * once; a buffer is reused as soon as the plane in it is released by
+ * Next(). Typical use:
+ *
+ *   for(FitsPlaneIterator<float> planes(reader); !planes.AtEnd(); planes.Next())
+ *   {
+ *     float* plane = planes.Plane();
+ *     ...
+ *   }
+ *
+ * The reader is used by the background thread while the iterator exists,
+ * so it should not be used for reading in the mean time. Using other FITS
+ * files at the same time is only safe when cfitsio was built reentrant, see
+ * fits_is_reentrant(). Instantiated for float and double.
+ */
+template<typename NumType>
+class FitsPlaneIterator
+{
+public:
+	/**
+	 * @param depth Number of plane buffers, at least one. With two buffers (the
+	 * default), the next plane is read while the current one is processed; more
+	 * buffers smooth out variations in read and processing times.
+	 */
+	explicit FitsPlaneIterator(class FitsReader& reader, size_t depth = 2);
+	
+	/**
+	 * Stops reading ahead and waits for the background thread.
+	 */
+	~FitsPlaneIterator();
+	
+	FitsPlaneIterator(const FitsPlaneIterator&) = delete;
+	FitsPlaneIterator& operator=(const FitsPlaneIterator&) = delete;
+	
+	bool AtEnd() const { return _current >= _nPlanes; }
+	
+	/** Index of the current plane, as used by FitsReader::ReadIndex(). */
+	size_t Index() const { return _current; }
+	
+	/**
+	 * The current plane, of ImageWidth() x ImageHeight() values. Waits until
+	 * it has been read, and rethrows the exception if reading it failed. The
+	 * buffer may be modified, and stays valid until Next() is called. Throws
+	 * when AtEnd().
+	 */
+	NumType* Plane();
+	
+	/**
+	 * Release the current plane and move to the next.
+	 */
+	void Next();
+	
+private:
+	void readPlanes();
+	
+	class FitsReader& _reader;
+	size_t _planeSize, _nPlanes, _depth;
+	std::vector<ao::uvector<NumType>> _buffers;
+	
+	/** Plane that is being processed; planes before it have been released. */
+	size_t _current;
+	/** Number of planes that have been read. */
+	size_t _nRead;
+	bool _stop;
+	std::exception_ptr _exception;
+	std::mutex _mutex;
+	std::condition_variable _readCondition, _releaseCondition;
+	std::thread _thread;
+};
+
+#endif
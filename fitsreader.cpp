@@ -5,14 +5,12 @@
 #include <stdexcept>
 #include <sstream>
 #include <cmath>
-
-#include <casacore/fits/FITS/FITSDateUtil.h>
-#include <casacore/casa/Quanta/MVTime.h>
-#include <casacore/measures/Measures/MeasConvert.h>
+#include <cstring>
 
 FitsReader::FitsReader(const FitsReader& source) :
 	_filename(source._filename),
-	_fitsPtr(0),
+	_fitsPtr(nullptr),
+	_keywords(source._keywords),
 	_imgWidth(source._imgWidth), _imgHeight(source._imgHeight),
 	_nAntennas(source._nAntennas),
 	_nFrequencies(source._nFrequencies),
@@ -28,24 +26,19 @@ FitsReader::FitsReader(const FitsReader& source) :
 	_telescopeName(source._telescopeName), _observer(source._observer), _objectName(source._objectName),
 	_origin(source._origin), _originComment(source._originComment),
 	_history(source._history),
+	_extraAxes(source._extraAxes),
 	_checkCType(source._checkCType),
 	_allowMultipleImages(source._allowMultipleImages)
 {
-	int status = 0;
-	fits_open_file(&_fitsPtr, _filename.c_str(), READONLY, &status);
-	checkStatus(status, _filename);
-	
-	// Move to first HDU
-	int hduType;
-	fits_movabs_hdu(_fitsPtr, 1, &hduType, &status);
-	checkStatus(status, _filename);
-	if(hduType != IMAGE_HDU) throw std::runtime_error("First HDU is not an image");
 }
 
 FitsReader::~FitsReader()
 {
-	int status = 0;
-	fits_close_file(_fitsPtr, &status);
+	if(_fitsPtr != nullptr)
+	{
+		int status = 0;
+		fits_close_file(_fitsPtr, &status);
+	}
 }
 
 FitsReader& FitsReader::operator=(const FitsReader& rhs)
@@ -77,29 +70,56 @@ FitsReader& FitsReader::operator=(const FitsReader& rhs)
 	_origin = rhs._origin;
 	_originComment = rhs._originComment;
 	_history = rhs._history;
+	_extraAxes = rhs._extraAxes;
 	_checkCType = rhs._checkCType;
 	_allowMultipleImages = rhs._allowMultipleImages;
+	_keywords = rhs._keywords;
 	
-	int status = 0;
-	fits_close_file(_fitsPtr, &status);
-	checkStatus(status, _filename);
-	
-	fits_open_file(&_fitsPtr, _filename.c_str(), READONLY, &status);
-	checkStatus(status, _filename);
-	
-	// Move to first HDU
-	int hduType;
-	fits_movabs_hdu(_fitsPtr, 1, &hduType, &status);
-	checkStatus(status, _filename);
-	if(hduType != IMAGE_HDU) throw std::runtime_error("First HDU is not an image");
+	// The file is reopened when it is needed
+	if(_fitsPtr != nullptr)
+	{
+		int status = 0;
+		fits_close_file(_fitsPtr, &status);
+		_fitsPtr = nullptr;
+		checkStatus(status, _filename);
+	}
 	return *this;
 }
 
+void FitsReader::openFile() const
+{
+	if(_fitsPtr == nullptr)
+	{
+		int status = 0;
+		fits_open_file(&_fitsPtr, _filename.c_str(), READONLY, &status);
+		checkStatus(status, _filename);
+		
+		// Move to first HDU
+		int hduType;
+		fits_movabs_hdu(_fitsPtr, 1, &hduType, &status);
+		checkStatus(status, _filename);
+		if(hduType != IMAGE_HDU) throw std::runtime_error("First HDU is not an image");
+	}
+}
+
+const FitsReader::Keyword* FitsReader::findKeyword(const char* key) const
+{
+	std::map<std::string, Keyword>::const_iterator keyword = _keywords.find(key);
+	if(keyword == _keywords.end())
+		return nullptr;
+	else
+		return &keyword->second;
+}
+
 double FitsReader::readDoubleKey(const char *key)
 {
 	int status = 0;
-	double value;
-	fits_read_key(_fitsPtr, TDOUBLE, key, &value, 0, &status);
+	double value = 0.0;
+	const Keyword* keyword = findKeyword(key);
+	if(keyword == nullptr)
+		status = KEY_NO_EXIST;
+	else
+		ffc2d(keyword->value.c_str(), &value, &status);
 	checkStatus(status, _filename, std::string("Read float key ") + key);
 	return value;
 }
@@ -108,7 +128,10 @@ bool FitsReader::ReadFloatKeyIfExists(const char *key, float &dest)
 {
 	int status = 0;
 	float floatValue;
-	fits_read_key(_fitsPtr, TFLOAT, key, &floatValue, 0, &status);
+	const Keyword* keyword = findKeyword(key);
+	if(keyword == nullptr)
+		return false;
+	ffc2r(keyword->value.c_str(), &floatValue, &status);
 	if(status == 0)
 		dest = floatValue;
 	return status == 0;
@@ -118,7 +141,10 @@ bool FitsReader::ReadDoubleKeyIfExists(const char *key, double &dest)
 {
 	int status = 0;
 	double doubleValue;
-	fits_read_key(_fitsPtr, TDOUBLE, key, &doubleValue, 0, &status);
+	const Keyword* keyword = findKeyword(key);
+	if(keyword == nullptr)
+		return false;
+	ffc2d(keyword->value.c_str(), &doubleValue, &status);
 	if(status == 0)
 		dest = doubleValue;
 	return status == 0;
@@ -126,12 +152,10 @@ bool FitsReader::ReadDoubleKeyIfExists(const char *key, double &dest)
 
 bool FitsReader::readDateKeyIfExists(const char *key, double &dest)
 {
-	int status = 0;
-	char keyStr[256];
-	fits_read_key(_fitsPtr, TSTRING, key, keyStr, 0, &status);
-	if(status == 0)
+	std::string value;
+	if(ReadStringKeyIfExists(key, value))
 	{
-		dest = FitsReader::ParseFitsDateToMJD(keyStr);
+		dest = FitsReader::ParseFitsDateToMJD(value.c_str());
 		return true;
 	}
 	else return false;
@@ -139,22 +163,24 @@ bool FitsReader::readDateKeyIfExists(const char *key, double &dest)
 
 std::string FitsReader::readStringKey(const char *key)
 {
-	int status = 0;
-	char keyStr[256];
-	fits_read_key(_fitsPtr, TSTRING, key, keyStr, 0, &status);
-	checkStatus(status, _filename, std::string("Read string key ") + key);
-	return std::string(keyStr);
+	std::string value, comment;
+	if(!ReadStringKeyIfExists(key, value, comment))
+		checkStatus(KEY_NO_EXIST, _filename, std::string("Read string key ") + key);
+	return value;
 }
 
 bool FitsReader::ReadStringKeyIfExists(const char *key, std::string& value, std::string& comment)
 {
 	int status = 0;
-	char valueStr[256], commentStr[256];
-	fits_read_key(_fitsPtr, TSTRING, key, valueStr, commentStr, &status);
+	char valueStr[FLEN_VALUE];
+	const Keyword* keyword = findKeyword(key);
+	if(keyword == nullptr)
+		return false;
+	ffc2s(keyword->value.c_str(), valueStr, &status);
 	if(status == 0)
 	{
 		value = valueStr;
-		comment = commentStr;
+		comment = keyword->comment;
 	}
 	return status == 0;
 }
@@ -173,16 +199,10 @@ void FitsReader::initialize()
 	_bandwidth = 0.0;
 	_polarization = Polarization::StokesI;
 	
-	int status = 0;
-	fits_open_file(&_fitsPtr, _filename.c_str(), READONLY, &status);
-	checkStatus(status, _filename);
-	
-	// Move to first HDU
-	int hduType;
-	fits_movabs_hdu(_fitsPtr, 1, &hduType, &status);
-	checkStatus(status, _filename);
-	if(hduType != IMAGE_HDU) throw std::runtime_error("First HDU is not an image");
+	openFile();
+	readHeader();
 	
+	int status = 0;
 	int naxis = 0;
 	fits_get_img_dim(_fitsPtr, &naxis, &status);
 	checkStatus(status, _filename);
@@ -195,32 +215,45 @@ void FitsReader::initialize()
 	_imgWidth = naxes[0];
 	_imgHeight = naxes[1];
 	
+	_extraAxes.clear();
 	std::string tmp;
 	for(int i=2;i!=naxis;++i)
 	{
-		std::ostringstream name;
+		if(naxes[i] == 0)
+			throw std::runtime_error("Image has an axis of size zero");
+		_extraAxes.emplace_back(Axis{OtherAxis, size_t(naxes[i]), 0.0, 0.0, 1.0});
+		std::ostringstream name, crpix, crval, cdelt;
 		name << "CTYPE" << (i+1);
+		crpix << "CRPIX" << (i+1);
+		crval << "CRVAL" << (i+1);
+		cdelt << "CDELT" << (i+1);
+		ReadDoubleKeyIfExists(crpix.str().c_str(), _extraAxes.back().refPixel);
+		ReadDoubleKeyIfExists(crval.str().c_str(), _extraAxes.back().refValue);
+		ReadDoubleKeyIfExists(cdelt.str().c_str(), _extraAxes.back().increment);
 		if(ReadStringKeyIfExists(name.str().c_str(), tmp))
 		{
-			std::ostringstream crval, cdelt;
-			crval << "CRVAL" << (i+1);
-			cdelt << "CDELT" << (i+1);
 			if(tmp.substr(0, 4) == "FREQ" || tmp == "VRAD")
 			{
 				_nFrequencies = naxes[i];
+				_extraAxes.back().type = FrequencyAxis;
 				_frequency = readDoubleKey(crval.str().c_str());
 				_bandwidth = readDoubleKey(cdelt.str().c_str());
 			}
 			else if(tmp == "ANTENNA")
+			{
 				_nAntennas = naxes[i];
+				_extraAxes.back().type = AntennaAxis;
+			}
 			else if(tmp == "TIME")
 			{
 				_nTimesteps = naxes[i];
+				_extraAxes.back().type = TimeAxis;
 				_timeDimensionStart = readDoubleKey(crval.str().c_str());
 				_timeDimensionIncr = readDoubleKey(cdelt.str().c_str());
 			}
 			else if(tmp == "STOKES")
 			{
+				_extraAxes.back().type = PolarizationAxis;
 				double val = readDoubleKey(crval.str().c_str());
 				switch(int(val))
 				{
@@ -332,9 +365,6 @@ void FitsReader::initialize()
 	_origin = std::string();
 	_originComment = std::string();
 	ReadStringKeyIfExists("ORIGIN", _origin, _originComment);
-	
-	_history.clear();
-	readHistory();
 }
 
 template void FitsReader::ReadIndex(float* image, size_t index);
@@ -343,48 +373,207 @@ template void FitsReader::ReadIndex(double* image, size_t index);
 template<typename NumType>
 void FitsReader::ReadIndex(NumType* image, size_t index)
 {
-	int status = 0;
-	int naxis = 0;
-	fits_get_img_dim(_fitsPtr, &naxis, &status);
-	checkStatus(status, _filename);
-	std::vector<long> firstPixel(naxis);
-	for(int i=0;i!=naxis;++i) firstPixel[i] = 1;
-	if(naxis > 2)
-		firstPixel[2] = index+1;
-	
+	ReadRows(image, 0, _imgHeight, index);
+}
+
+template void FitsReader::ReadRegion(float* image, size_t x0, size_t y0, size_t width, size_t height, size_t index);
+template void FitsReader::ReadRegion(double* image, size_t x0, size_t y0, size_t width, size_t height, size_t index);
+
+template<typename NumType>
+void FitsReader::ReadRegion(NumType* image, size_t x0, size_t y0, size_t width, size_t height, size_t index)
+{
+	if(x0 + width > _imgWidth || y0 + height > _imgHeight)
+		throw std::runtime_error("Region to read lies outside the image");
+	int dataType;
 	if(sizeof(NumType)==8)
-		fits_read_pix(_fitsPtr, TDOUBLE, &firstPixel[0], _imgWidth*_imgHeight, 0, image, 0, &status);
+		dataType = TDOUBLE;
 	else if(sizeof(NumType)==4)
-		fits_read_pix(_fitsPtr, TFLOAT, &firstPixel[0], _imgWidth*_imgHeight, 0, image, 0, &status);
+		dataType = TFLOAT;
 	else
 		throw std::runtime_error("sizeof(NumType)!=8 || 4 not implemented");
+	
+	openFile();
+	int status = 0;
+	std::vector<long> firstPixel(2 + _extraAxes.size());
+	firstPixel[0] = x0+1;
+	firstPixel[1] = y0+1;
+	setPlanePixel(firstPixel, index);
+	if(width == _imgWidth)
+	{
+		// Full rows are contiguous in the file
+		fits_read_pix(_fitsPtr, dataType, &firstPixel[0], width*height, 0, image, 0, &status);
+	}
+	else {
+		std::vector<long> lastPixel(firstPixel), increment(firstPixel.size(), 1);
+		lastPixel[0] = x0+width;
+		lastPixel[1] = y0+height;
+		fits_read_subset(_fitsPtr, dataType, &firstPixel[0], &lastPixel[0], &increment[0], 0, image, 0, &status);
+	}
 	checkStatus(status, _filename);
 }
 
-void FitsReader::readHistory()
+void FitsReader::setPlanePixel(std::vector<long>& pixel, size_t index) const
+{
+	for(size_t i=0; i!=_extraAxes.size(); ++i)
+	{
+		pixel[i+2] = index % _extraAxes[i].size + 1;
+		index /= _extraAxes[i].size;
+	}
+}
+
+size_t FitsReader::NImages() const
+{
+	size_t n = 1;
+	for(const Axis& axis : _extraAxes)
+		n *= axis.size;
+	return n;
+}
+
+size_t FitsReader::AxisIndex(size_t imageIndex, AxisType type) const
+{
+	for(const Axis& axis : _extraAxes)
+	{
+		if(axis.type == type)
+			return imageIndex % axis.size;
+		imageIndex /= axis.size;
+	}
+	return 0;
+}
+
+double FitsReader::PlaneFrequency(size_t imageIndex) const
+{
+	for(const Axis& axis : _extraAxes)
+	{
+		if(axis.type == FrequencyAxis)
+		{
+			// FITS pixels along an axis count from 1
+			const double pixel = imageIndex % axis.size + 1;
+			return axis.refValue + (pixel - axis.refPixel) * axis.increment;
+		}
+		imageIndex /= axis.size;
+	}
+	return _frequency;
+}
+
+void FitsReader::readHeader()
 {
 	int status = 0;
-	int npos, moreKeys;
-	fits_get_hdrspace(_fitsPtr, &npos, &moreKeys, &status);
+	int nKeys, moreKeys;
+	fits_get_hdrspace(_fitsPtr, &nKeys, &moreKeys, &status);
 	checkStatus(status, _filename);
-	char keyCard[256];
-	for(int pos=1; pos<=npos; ++pos)
+	_keywords.clear();
+	_history.clear();
+	char card[FLEN_CARD], name[FLEN_KEYWORD], value[FLEN_VALUE], comment[FLEN_COMMENT];
+	for(int pos=1; pos<=nKeys; ++pos)
 	{
-		fits_read_record(_fitsPtr, pos, keyCard, &status);
-		keyCard[7] = 0;
-		if(std::string("HISTORY") == keyCard) {
-			_history.push_back(&keyCard[8]);
+		fits_read_record(_fitsPtr, pos, card, &status);
+		checkStatus(status, _filename);
+		if(strncmp(card, "HISTORY", 7) == 0)
+		{
+			_history.push_back(strlen(card) > 8 ? &card[8] : "");
+			continue;
 		}
+		// Cards without a value, like COMMENT, give an empty value
+		int nameLength;
+		fits_get_keyname(card, name, &nameLength, &status);
+		fits_parse_value(card, value, comment, &status);
+		if(status == 0 && nameLength != 0)
+			_keywords.insert(std::make_pair(std::string(name), Keyword{value, comment}));
+		status = 0;
+	}
+}
+
+/**
+ * Parses a fixed number of decimal digits.
+ * @returns false when one of the characters is not a digit.
+ */
+static bool parseDigits(const char*& str, size_t nDigits, int& value)
+{
+	value = 0;
+	for(size_t i=0; i!=nDigits; ++i)
+	{
+		if(*str < '0' || *str > '9')
+			return false;
+		value = value*10 + (*str - '0');
+		++str;
 	}
+	return true;
 }
 
+/**
+ * Number of days since 1970-01-01 of a date in the proleptic Gregorian
+ * calendar, using the 400-year cycle of the calendar.
+ */
+static long daysFromCivil(int year, int month, int day)
+{
+	year -= month <= 2;
+	const long era = (year >= 0 ? year : year-399) / 400;
+	const long yearOfEra = year - era * 400;
+	const long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	const long dayOfEra = yearOfEra * 365 + yearOfEra/4 - yearOfEra/100 + dayOfYear;
+	return era * 146097 + dayOfEra - 719468;
+}
+
+/**
+ * Parses the DATE-OBS formats of the FITS standard: "YYYY-MM-DD",
+ * "YYYY-MM-DDThh:mm:ss[.s...]" and the old "DD/MM/YY" for years 1900-1999.
+ * The time is taken as is, without a conversion between time systems.
+ */
 double FitsReader::ParseFitsDateToMJD(const char* valueStr)
 {
-	casacore::MVTime time;
-	casacore::MEpoch::Types systypes;
-	bool parseSuccess = casacore::FITSDateUtil::fromFITS(time, systypes, valueStr, "UTC");
-	if(!parseSuccess)
+	const char* str = valueStr;
+	while(*str == ' ')
+		++str;
+	int year = 0, month = 0, day = 0, hour = 0, minutes = 0;
+	double seconds = 0.0;
+	bool valid;
+	if(str[0] != '\0' && str[1] != '\0' && str[2] == '/')
+	{
+		valid =
+			parseDigits(str, 2, day) && *str++ == '/' &&
+			parseDigits(str, 2, month) && *str++ == '/' &&
+			parseDigits(str, 2, year);
+		year += 1900;
+	}
+	else {
+		valid =
+			parseDigits(str, 4, year) && *str++ == '-' &&
+			parseDigits(str, 2, month) && *str++ == '-' &&
+			parseDigits(str, 2, day);
+		if(valid && *str == 'T')
+		{
+			++str;
+			int wholeSeconds = 0;
+			valid =
+				parseDigits(str, 2, hour) && *str++ == ':' &&
+				parseDigits(str, 2, minutes) && *str++ == ':' &&
+				parseDigits(str, 2, wholeSeconds);
+			seconds = wholeSeconds;
+			if(valid && *str == '.')
+			{
+				++str;
+				double scale = 0.1;
+				while(*str >= '0' && *str <= '9')
+				{
+					seconds += (*str - '0') * scale;
+					scale *= 0.1;
+					++str;
+				}
+			}
+		}
+	}
+	if(valid && *str == 'Z')
+		++str;
+	while(valid && *str == ' ')
+		++str;
+	const int monthDays[12] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	const bool isLeapYear = (year%4 == 0 && year%100 != 0) || year%400 == 0;
+	if(!valid || *str != '\0' ||
+		month < 1 || month > 12 || day < 1 || day > monthDays[month-1] ||
+		(month == 2 && day == 29 && !isLeapYear) ||
+		hour > 23 || minutes > 59 || seconds >= 61.0)
 		throw std::runtime_error(std::string("Could not parse FITS date: ") + valueStr);
-	casacore::MEpoch epoch(time.get(), systypes);
-	return epoch.getValue().get();
+	// MJD 0 is 1858-11-17, which is 40587 days before 1970-01-01
+	return double(daysFromCivil(year, month, day) + 40587) +
+		(hour * 3600.0 + minutes * 60.0 + seconds) / 86400.0;
 }
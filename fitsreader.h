@@ -1,6 +1,7 @@
 #ifndef FITSREADER_H
 #define FITSREADER_H
 
+#include <map>
 #include <string>
 #include <vector>
 
@@ -12,11 +13,27 @@
 class FitsReader : public FitsIOChecker
 {
 	public:
+		enum AxisType {
+			FrequencyAxis,
+			PolarizationAxis,
+			AntennaAxis,
+			TimeAxis,
+			OtherAxis
+		};
+		
+		struct Axis
+		{
+			AxisType type;
+			size_t size;
+			/** CRPIX, CRVAL and CDELT of the axis, with the FITS defaults when missing */
+			double refPixel, refValue, increment;
+		};
+		
 		explicit FitsReader(const std::string &filename) 
 		: FitsReader(filename, true, false)
 		{ }
 		explicit FitsReader(const std::string &filename, bool checkCType, bool allowMultipleImages=false) :
-			_filename(filename), _hasBeam(false),
+			_filename(filename), _fitsPtr(nullptr), _hasBeam(false),
 			_checkCType(checkCType), _allowMultipleImages(allowMultipleImages)
 		{
 			initialize(); 
@@ -28,6 +45,29 @@ class FitsReader : public FitsIOChecker
 		
 		template<typename NumType> void ReadIndex(NumType *image, size_t index);
 		
+		/**
+		 * Read a block of consecutive full rows from one image plane.
+		 * @param image Output buffer of size ImageWidth() x nRows.
+		 * @param rowStart Index of the first row to read.
+		 * @param nRows Number of rows to read.
+		 * @param index Index of the plane in the file.
+		 */
+		template<typename NumType> void ReadRows(NumType *image, size_t rowStart, size_t nRows, size_t index=0)
+		{
+			ReadRegion(image, 0, rowStart, _imgWidth, nRows, index);
+		}
+		
+		/**
+		 * Read a rectangular part of one image plane.
+		 * @param image Output buffer of size width x height.
+		 * @param x0 First column to read.
+		 * @param y0 First row to read.
+		 * @param width Number of columns to read.
+		 * @param height Number of rows to read.
+		 * @param index Index of the plane in the file.
+		 */
+		template<typename NumType> void ReadRegion(NumType *image, size_t x0, size_t y0, size_t width, size_t height, size_t index=0);
+		
 		template<typename NumType> void Read(NumType *image)
 		{
 			ReadIndex(image, 0);
@@ -79,7 +119,11 @@ class FitsReader : public FitsIOChecker
 		
 		const std::string& Filename() const { return _filename; }
 		
-		fitsfile* FitsHandle() const { return _fitsPtr; }
+		/**
+		 * The cfitsio handle of the file. Copies of a reader share the parsed header
+		 * and open their own handle only once it is needed.
+		 */
+		fitsfile* FitsHandle() const { openFile(); return _fitsPtr; }
 		
 		size_t NFrequencies() const { return _nFrequencies; }
 		size_t NAntennas() const { return _nAntennas; }
@@ -89,16 +133,55 @@ class FitsReader : public FitsIOChecker
 		double TimeDimensionIncr() const { return _timeDimensionIncr; }
 		
 		enum Projection ProjectionType() const { return _projection; }
+		
+		/**
+		 * The axes after the two image axes, in the order of the file.
+		 */
+		const std::vector<Axis>& ExtraAxes() const { return _extraAxes; }
+		
+		/**
+		 * Number of images (planes) in the file, which is the product of the sizes of
+		 * the extra axes. Planes are indexed with the first extra axis varying fastest,
+		 * as in the file.
+		 */
+		size_t NImages() const;
+		
+		/**
+		 * Position along an axis of the plane with the given index, or 0 if the file
+		 * has no axis of that type.
+		 */
+		size_t AxisIndex(size_t imageIndex, AxisType type) const;
+		
+		/**
+		 * Frequency of the plane with the given index, calculated from the CRPIX, CRVAL
+		 * and CDELT of the frequency axis. Same as Frequency() if the file has no
+		 * frequency axis.
+		 */
+		double PlaneFrequency(size_t imageIndex) const;
 	private:
+		struct Keyword
+		{
+			std::string value, comment;
+		};
+		
 		double readDoubleKey(const char* key);
 		std::string readStringKey(const char* key);
-		void readHistory();
+		void readHeader();
+		void openFile() const;
+		const Keyword* findKeyword(const char* key) const;
 		bool readDateKeyIfExists(const char *key, double &dest);
 		
 		void initialize();
+		void setPlanePixel(std::vector<long>& pixel, size_t index) const;
 		
 		std::string _filename;
-		fitsfile *_fitsPtr;
+		mutable fitsfile *_fitsPtr;
+		/**
+		 * All keywords of the header with their unparsed values, read in a single
+		 * pass on opening. For keywords that occur more than once, the first one
+		 * is stored, as fits_read_key() would find.
+		 */
+		std::map<std::string, Keyword> _keywords;
 		
 		size_t _imgWidth, _imgHeight;
 		size_t _nAntennas, _nFrequencies, _nTimesteps;
@@ -116,6 +199,7 @@ class FitsReader : public FitsIOChecker
 		std::string _telescopeName, _observer, _objectName;
 		std::string _origin, _originComment;
 		std::vector<std::string> _history;
+		std::vector<Axis> _extraAxes;
 		
 		bool _checkCType, _allowMultipleImages;
 };
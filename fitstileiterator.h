@@ -0,0 +1,70 @@
+#ifndef FITS_TILE_ITERATOR_H
+#define FITS_TILE_ITERATOR_H
+
+#include "fitsreader.h"
+
+#include <algorithm>
+#include <cstddef>
+
+/**
+ * Walks over one plane of an image in rectangular tiles, row of tiles by row
+ * of tiles, so that an image can be processed without holding a full plane in
+ * memory. Tiles at the right and bottom borders are smaller when the image
+ * size is not a multiple of the tile size. Typical use:
+ *
+ *   for(FitsTileIterator tile(reader, 512, 512); !tile.AtEnd(); tile.Next())
+ *   {
+ *     tile.Read(buffer.data());
+ *     ...
+ *   }
+ */
+class FitsTileIterator
+{
+public:
+	/**
+	 * Tile size that keeps a tile of doubles (2 MB) within a typical
+	 * second-level cache.
+	 */
+	static constexpr size_t DefaultTileSize = 512;
+	
+	FitsTileIterator(FitsReader& reader, size_t tileWidth = DefaultTileSize, size_t tileHeight = DefaultTileSize, size_t index = 0) :
+		_reader(reader),
+		_tileWidth(std::max<size_t>(tileWidth, 1)),
+		_tileHeight(std::max<size_t>(tileHeight, 1)),
+		_index(index),
+		_x(0), _y(0)
+	{ }
+	
+	bool AtEnd() const { return _y >= _reader.ImageHeight() || _reader.ImageWidth() == 0; }
+	
+	void Next()
+	{
+		_x += _tileWidth;
+		if(_x >= _reader.ImageWidth())
+		{
+			_x = 0;
+			_y += _tileHeight;
+		}
+	}
+	
+	size_t X() const { return _x; }
+	size_t Y() const { return _y; }
+	size_t Width() const { return std::min(_tileWidth, _reader.ImageWidth() - _x); }
+	size_t Height() const { return std::min(_tileHeight, _reader.ImageHeight() - _y); }
+	
+	/**
+	 * Read the current tile into a buffer of Width() x Height() values.
+	 */
+	template<typename NumType>
+	void Read(NumType* tile) const
+	{
+		_reader.ReadRegion(tile, _x, _y, Width(), Height(), _index);
+	}
+	
+private:
+	FitsReader& _reader;
+	size_t _tileWidth, _tileHeight, _index;
+	size_t _x, _y;
+};
+
+#endif
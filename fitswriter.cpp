@@ -16,11 +16,10 @@ void FitsWriter::writeHeaders(fitsfile*& fptr, const std::string& filename) cons
 {
 	if(_extraDimensions.empty())
 	{
-		std::vector<Dimension> dimensions(2);
-		dimensions[0].type = FrequencyDimension;
-		dimensions[0].size = 1;
-		dimensions[1].type = PolarizationDimension;
-		dimensions[1].size = 1;
+		const std::vector<Dimension> dimensions = {
+			Dimension{FrequencyDimension, 1, false, 1.0, 0.0, 1.0},
+			Dimension{PolarizationDimension, 1, false, 1.0, 0.0, 1.0}
+		};
 		writeHeaders(fptr, filename, dimensions);
 	}
 	else {
@@ -41,7 +40,7 @@ void FitsWriter::writeHeaders(fitsfile *& fptr, const std::string& filename, con
 	naxes[1] = _height;
 	for(size_t i=0; i!=extraDimensions.size(); ++i)
 		naxes[i+2] = extraDimensions[i].size;
-	fits_create_img(fptr, bitPixInt, 4, naxes.data(), &status);
+	fits_create_img(fptr, bitPixInt, naxes.size(), naxes.data(), &status);
 	checkStatus(status, filename);
 	double zero = 0, one = 1, equinox = 2000.0;
 	fits_write_key(fptr, TDOUBLE, "BSCALE", (void*) &one, "", &status); checkStatus(status, filename);
@@ -157,51 +156,71 @@ void FitsWriter::writeHeaders(fitsfile *& fptr, const std::string& filename, con
 		crvalDim[5] = (i+'3');
 		cdeltDim[5] = (i+'3');
 		cunitDim[5] = (i+'3');
-		switch(extraDimensions[i].type)
+		// Dimensions that were copied from an input image keep its coordinates
+		const Dimension& dimension = extraDimensions[i];
+		double
+			refPixel = dimension.refPixel,
+			refValue = dimension.refValue,
+			increment = dimension.increment;
+		switch(dimension.type)
 		{
 		case FrequencyDimension:
+			if(!dimension.hasReference)
+			{
+				refValue = _frequency;
+				increment = _bandwidth;
+			}
 			fits_write_key(fptr, TSTRING, ctypeDim, (void*) "FREQ", "Central frequency", &status); checkStatus(status, filename);
-			fits_write_key(fptr, TDOUBLE, crpixDim, (void*) &one, "", &status); checkStatus(status, filename);
-			fits_write_key(fptr, TDOUBLE, crvalDim, (void*) &_frequency, "", &status); checkStatus(status, filename);
-			fits_write_key(fptr, TDOUBLE, cdeltDim, (void*) &_bandwidth, "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TDOUBLE, crpixDim, (void*) &refPixel, "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TDOUBLE, crvalDim, (void*) &refValue, "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TDOUBLE, cdeltDim, (void*) &increment, "", &status); checkStatus(status, filename);
 			fits_write_key(fptr, TSTRING, cunitDim, (void*) "Hz", "", &status); checkStatus(status, filename);
 			break;
 		case PolarizationDimension:
+			if(!dimension.hasReference)
 			{
-				double pol;
 				switch(_polarization)
 				{
-					case Polarization::StokesI: pol = 1.0; break;
-					case Polarization::StokesQ: pol = 2.0; break;
-					case Polarization::StokesU: pol = 3.0; break;
-					case Polarization::StokesV: pol = 4.0; break;
-					case Polarization::RR: pol = -1.0; break;
-					case Polarization::LL: pol = -2.0; break;
-					case Polarization::RL: pol = -3.0; break;
-					case Polarization::LR: pol = -4.0; break;
-					case Polarization::XX: pol = -5.0; break;
-					case Polarization::YY: pol = -6.0; break; //yup, this is really the right value
-					case Polarization::XY: pol = -7.0; break;
-					case Polarization::YX: pol = -8.0; break;
+					case Polarization::StokesI: refValue = 1.0; break;
+					case Polarization::StokesQ: refValue = 2.0; break;
+					case Polarization::StokesU: refValue = 3.0; break;
+					case Polarization::StokesV: refValue = 4.0; break;
+					case Polarization::RR: refValue = -1.0; break;
+					case Polarization::LL: refValue = -2.0; break;
+					case Polarization::RL: refValue = -3.0; break;
+					case Polarization::LR: refValue = -4.0; break;
+					case Polarization::XX: refValue = -5.0; break;
+					case Polarization::YY: refValue = -6.0; break; //yup, this is really the right value
+					case Polarization::XY: refValue = -7.0; break;
+					case Polarization::YX: refValue = -8.0; break;
 					case Polarization::Instrumental:
 						throw std::runtime_error("Incorrect polarization given to fits writer");
 				}
-				fits_write_key(fptr, TSTRING, ctypeDim, (void*) "STOKES", "", &status); checkStatus(status, filename);
-				fits_write_key(fptr, TDOUBLE, crpixDim, (void*) &one, "", &status); checkStatus(status, filename);
-				fits_write_key(fptr, TDOUBLE, crvalDim, (void*) &pol, "", &status); checkStatus(status, filename);
-				fits_write_key(fptr, TDOUBLE, cdeltDim, (void*) &one, "", &status); checkStatus(status, filename);
-				fits_write_key(fptr, TSTRING, cunitDim, (void*) "", "", &status); checkStatus(status, filename);
+				increment = 1.0;
 			}
+			fits_write_key(fptr, TSTRING, ctypeDim, (void*) "STOKES", "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TDOUBLE, crpixDim, (void*) &refPixel, "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TDOUBLE, crvalDim, (void*) &refValue, "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TDOUBLE, cdeltDim, (void*) &increment, "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TSTRING, cunitDim, (void*) "", "", &status); checkStatus(status, filename);
 			break;
 		case AntennaDimension:
 			fits_write_key(fptr, TSTRING, ctypeDim, (void*) "ANTENNA", "", &status); checkStatus(status, filename);
-			fits_write_key(fptr, TDOUBLE, crpixDim, (void*) &one, "", &status); checkStatus(status, filename);
-			fits_write_key(fptr, TDOUBLE, crvalDim, (void*) &zero, "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TDOUBLE, crpixDim, (void*) &refPixel, "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TDOUBLE, crvalDim, (void*) &refValue, "", &status); checkStatus(status, filename);
+			if(dimension.hasReference)
+			{
+				fits_write_key(fptr, TDOUBLE, cdeltDim, (void*) &increment, "", &status); checkStatus(status, filename);
+			}
 			break;
 		case TimeDimension:
 			fits_write_key(fptr, TSTRING, ctypeDim, (void*) "TIME", "", &status); checkStatus(status, filename);
-			fits_write_key(fptr, TDOUBLE, crpixDim, (void*) &one, "", &status); checkStatus(status, filename);
-			fits_write_key(fptr, TDOUBLE, crvalDim, (void*) &zero, "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TDOUBLE, crpixDim, (void*) &refPixel, "", &status); checkStatus(status, filename);
+			fits_write_key(fptr, TDOUBLE, crvalDim, (void*) &refValue, "", &status); checkStatus(status, filename);
+			if(dimension.hasReference)
+			{
+				fits_write_key(fptr, TDOUBLE, cdeltDim, (void*) &increment, "", &status); checkStatus(status, filename);
+			}
 			break;
 		}
 	}
@@ -241,28 +260,28 @@ void FitsWriter::writeHeaders(fitsfile *& fptr, const std::string& filename, con
 	}
 }
 
-void FitsWriter::writeImage(fitsfile* fptr, const std::string& filename, const double* image, long* currentPixel) const
+void FitsWriter::writeImage(fitsfile* fptr, const std::string& filename, const double* image, long* currentPixel, size_t nPixels) const
 {
 	double nullValue = std::numeric_limits<double>::max();
 	int status = 0;
-	fits_write_pixnull(fptr, TDOUBLE, currentPixel, _width*_height, const_cast<double*>(image), &nullValue, &status);
+	fits_write_pixnull(fptr, TDOUBLE, currentPixel, nPixels, const_cast<double*>(image), &nullValue, &status);
 	checkStatus(status, filename);
 }
 
-void FitsWriter::writeImage(fitsfile* fptr, const std::string& filename, const float* image, long* currentPixel) const
+void FitsWriter::writeImage(fitsfile* fptr, const std::string& filename, const float* image, long* currentPixel, size_t nPixels) const
 {
 	float nullValue = std::numeric_limits<float>::max();
 	int status = 0;
-	fits_write_pixnull(fptr, TFLOAT, currentPixel, _width*_height, const_cast<float*>(image), &nullValue, &status);
+	fits_write_pixnull(fptr, TFLOAT, currentPixel, nPixels, const_cast<float*>(image), &nullValue, &status);
 	checkStatus(status, filename);
 }
 
 template<typename NumType>
-void FitsWriter::writeImage(fitsfile* fptr, const std::string& filename, const NumType* image, long* currentPixel) const
+void FitsWriter::writeImage(fitsfile* fptr, const std::string& filename, const NumType* image, long* currentPixel, size_t nPixels) const
 {
 	double nullValue = std::numeric_limits<double>::max();
 	int status = 0;
-	size_t totalSize = _width*_height;
+	size_t totalSize = nPixels;
 	std::vector<double> copy(totalSize);
 	for(size_t i=0;i!=totalSize;++i) copy[i] = image[i];
 	fits_write_pixnull(fptr, TDOUBLE, currentPixel, totalSize, &copy[0], &nullValue, &status);
@@ -284,8 +303,10 @@ void FitsWriter::Write(const std::string& filename, const NumType* image) const
 
 	writeHeaders(fptr, filename);
 	
-	long firstPixel[4] = { 1, 1, 1, 1};
-	writeImage(fptr, filename, image, firstPixel);
+	// writeHeaders() adds the frequency and polarization axes when there are no extra dimensions
+	const size_t nAxes = 2 + (_extraDimensions.empty() ? 2 : _extraDimensions.size());
+	std::vector<long> firstPixel(nAxes, 1);
+	writeImage(fptr, filename, image, firstPixel.data(), _width*_height);
 	
 	int status = 0;
 	fits_close_file(fptr, &status);
@@ -301,6 +322,12 @@ void FitsWriter::StartMulti(const std::string& filename)
 	if(_multiFPtr != 0)
 		throw std::runtime_error("StartMulti() called twice without calling FinishMulti()");
 	_multiFilename = filename;
+	// Same default dimensions as writeHeaders() uses for a single image
+	if(_extraDimensions.empty())
+	{
+		AddExtraDimension(FrequencyDimension, 1);
+		AddExtraDimension(PolarizationDimension, 1);
+	}
 	writeHeaders(_multiFPtr, _multiFilename, _extraDimensions);
 	_currentPixel.assign(_extraDimensions.size() + 2, 1);
 }
@@ -313,6 +340,25 @@ void FitsWriter::FinishMulti()
 	_multiFPtr = 0;
 }
 
+void FitsWriter::SetExtraDimensions(const FitsReader& reader)
+{
+	_extraDimensions.clear();
+	for(const FitsReader::Axis& axis : reader.ExtraAxes())
+	{
+		switch(axis.type)
+		{
+			case FitsReader::FrequencyAxis: AddExtraDimension(FrequencyDimension, axis.size, axis.refPixel, axis.refValue, axis.increment); break;
+			case FitsReader::PolarizationAxis: AddExtraDimension(PolarizationDimension, axis.size, axis.refPixel, axis.refValue, axis.increment); break;
+			case FitsReader::AntennaAxis: AddExtraDimension(AntennaDimension, axis.size, axis.refPixel, axis.refValue, axis.increment); break;
+			case FitsReader::TimeAxis: AddExtraDimension(TimeDimension, axis.size, axis.refPixel, axis.refValue, axis.increment); break;
+			case FitsReader::OtherAxis:
+				if(axis.size != 1)
+					throw std::runtime_error("Can not write an image with an axis of unknown type");
+				break;
+		}
+	}
+}
+
 void FitsWriter::SetMetadata(const FitsReader& reader)
 {
 	_width = reader.ImageWidth();
@@ -75,14 +75,29 @@ public:
 	{
 		if(_multiFPtr == 0)
 			throw std::runtime_error("AddToMulti() called before StartMulti()");
-		writeImage(_multiFPtr, _multiFilename, image, _currentPixel.data());
-		size_t index = 2;
-		_currentPixel[index]++;
-		while(index < _currentPixel.size()-1 && _currentPixel[index] > long(_extraDimensions[index-2].size))
+		writeImage(_multiFPtr, _multiFilename, image, _currentPixel.data(), _width*_height);
+		nextMultiImage();
+	}
+	
+	/**
+	 * Write a block of full rows to the image that was started with StartMulti().
+	 * Consecutive calls fill the current plane from the top down; once all
+	 * rows of a plane have been written, the next call starts the next plane.
+	 * A block should not extend past the last row of a plane.
+	 */
+	template<typename NumType>
+	void AddRowsToMulti(const NumType* rows, size_t nRows)
+	{
+		if(_multiFPtr == 0)
+			throw std::runtime_error("AddRowsToMulti() called before StartMulti()");
+		if(_currentPixel[1] - 1 + nRows > _height)
+			throw std::runtime_error("AddRowsToMulti() called with more rows than left in the image");
+		writeImage(_multiFPtr, _multiFilename, rows, _currentPixel.data(), _width*nRows);
+		_currentPixel[1] += nRows;
+		if(_currentPixel[1] > long(_height))
 		{
-			_currentPixel[index] = 1;
-			++index;
-			_currentPixel[index]++;
+			_currentPixel[1] = 1;
+			nextMultiImage();
 		}
 	}
 	
@@ -227,15 +242,38 @@ public:
 	
 	static void MJDToHMS(double mjd, int& hour, int& minutes, int& seconds, int& deciSec);
 	
+	/**
+	 * Add an axis after the image axes. Its coordinates are taken from the
+	 * frequency, bandwidth and polarization of the writer.
+	 */
 	void AddExtraDimension(enum DimensionType type, size_t size)
 	{
-		_extraDimensions.emplace_back(Dimension{type, size});
+		_extraDimensions.emplace_back(Dimension{type, size, false, 1.0, 0.0, 1.0});
+	}
+	
+	/**
+	 * Add an axis with the given coordinates, which are written as its CRPIX,
+	 * CRVAL and CDELT keywords.
+	 */
+	void AddExtraDimension(enum DimensionType type, size_t size, double refPixel, double refValue, double increment)
+	{
+		_extraDimensions.emplace_back(Dimension{type, size, true, refPixel, refValue, increment});
 	}
+	
+	/**
+	 * Replace the extra dimensions by those of the given image, so that a cube
+	 * can be written with the same axes and axis coordinates as it was read.
+	 * Axes of unknown type are left out, which is only allowed when their size
+	 * is one.
+	 */
+	void SetExtraDimensions(const class FitsReader& reader);
 private:
 	struct Dimension
 	{
 		DimensionType type;
 		size_t size;
+		bool hasReference;
+		double refPixel, refValue, increment;
 	};
 	
 	template<typename T>
@@ -264,10 +302,22 @@ private:
 	void julianDateToYMD(double jd, int &year, int &month, int &day) const;
 	void writeHeaders(fitsfile*& fptr, const std::string& filename) const;
 	void writeHeaders(fitsfile*& fptr, const std::string& filename, const std::vector<Dimension>& extraDimensions) const;
-	void writeImage(fitsfile* fptr, const std::string& filename, const double* image, long* currentPixel) const;
-	void writeImage(fitsfile* fptr, const std::string& filename, const float* image, long* currentPixel) const;
+	void writeImage(fitsfile* fptr, const std::string& filename, const double* image, long* currentPixel, size_t nPixels) const;
+	void writeImage(fitsfile* fptr, const std::string& filename, const float* image, long* currentPixel, size_t nPixels) const;
 	template<typename NumType>
-	void writeImage(fitsfile* fptr, const std::string& filename, const NumType* image, long* currentPixel) const;
+	void writeImage(fitsfile* fptr, const std::string& filename, const NumType* image, long* currentPixel, size_t nPixels) const;
+	
+	void nextMultiImage()
+	{
+		size_t index = 2;
+		_currentPixel[index]++;
+		while(index < _currentPixel.size()-1 && _currentPixel[index] > long(_extraDimensions[index-2].size))
+		{
+			_currentPixel[index] = 1;
+			++index;
+			_currentPixel[index]++;
+		}
+	}
 	
 	std::string _multiFilename;
 	fitsfile *_multiFPtr;
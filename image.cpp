@@ -2,45 +2,53 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 
-Image::Image(size_t width, size_t height) :
+template<typename NumT>
+ImageT<NumT>::ImageT(size_t width, size_t height) :
 	_data(width*height),
 	_width(width), _height(height)
 {
 }
 
-Image::Image(size_t width, size_t height, double initialValue) :
+template<typename NumT>
+ImageT<NumT>::ImageT(size_t width, size_t height, NumT initialValue) :
 	_data(width*height, initialValue),
 	_width(width), _height(height)
 {
 }
 
-Image::~Image()
+template<typename NumT>
+ImageT<NumT>::~ImageT()
 {
 }
 
-Image& Image::operator=(double value)
+template<typename NumT>
+ImageT<NumT>& ImageT<NumT>::operator=(NumT value)
 {
-	for(double& v : *this)
+	for(NumT& v : *this)
 		v = value;
 	return *this;
 }
 
-void Image::reset()
+template<typename NumT>
+void ImageT<NumT>::reset()
 {
 	_data.clear();
 	_width = 0;
 	_height = 0;
 }
 
-Image& Image::operator*=(double factor)
+template<typename NumT>
+ImageT<NumT>& ImageT<NumT>::operator*=(NumT factor)
 {
 	for(size_t i=0; i!=_width*_height; ++i)
 		_data[i] *= factor;
 	return *this;
 }
 
-Image& Image::operator*=(const Image& other)
+template<typename NumT>
+ImageT<NumT>& ImageT<NumT>::operator*=(const ImageT& other)
 {
 	for(size_t i=0; i!=_width*_height; ++i)
 		_data[i] *= other[i];
@@ -50,19 +58,21 @@ Image& Image::operator*=(const Image& other)
 // Cut-off the borders of an image.
 // @param outWidth Should be <= inWidth.
 // @param outHeight Should be <= inHeight.
-void Image::Trim(double* output, size_t outWidth, size_t outHeight, const double* input, size_t inWidth, size_t inHeight)
+template<typename NumT>
+void ImageT<NumT>::Trim(NumT* output, size_t outWidth, size_t outHeight, const NumT* input, size_t inWidth, size_t inHeight)
 {
 	size_t startX = (inWidth - outWidth) / 2;
 	size_t startY = (inHeight - outHeight) / 2;
 	size_t endY = (inHeight + outHeight) / 2;
 	for(size_t y=startY; y!=endY; ++y)
 	{
-		memcpy(&output[(y-startY)*outWidth], &input[y*inWidth + startX], outWidth*sizeof(double));
+		memcpy(&output[(y-startY)*outWidth], &input[y*inWidth + startX], outWidth*sizeof(NumT));
 	}
 }
 
+template<typename NumT>
 template<typename T>
-void Image::TrimBox(T* output, size_t x1, size_t y1, size_t boxWidth, size_t boxHeight, const T* input, size_t inWidth, size_t inHeight)
+void ImageT<NumT>::TrimBox(T* output, size_t x1, size_t y1, size_t boxWidth, size_t boxHeight, const T* input, size_t inWidth, size_t inHeight)
 {
 	size_t endY = y1 + boxHeight;
 	for(size_t y=y1; y!=endY; ++y)
@@ -71,13 +81,16 @@ void Image::TrimBox(T* output, size_t x1, size_t y1, size_t boxWidth, size_t box
 	}
 }
 template
-void Image::TrimBox(double* output, size_t x1, size_t y1, size_t boxWidth, size_t boxHeight, const double* input, size_t inWidth, size_t inHeight);
+void ImageT<double>::TrimBox(double* output, size_t x1, size_t y1, size_t boxWidth, size_t boxHeight, const double* input, size_t inWidth, size_t inHeight);
+template
+void ImageT<float>::TrimBox(float* output, size_t x1, size_t y1, size_t boxWidth, size_t boxHeight, const float* input, size_t inWidth, size_t inHeight);
 
 /** Extend an image with zeros, complement of Trim.
 	* @param outWidth Should be &gt;= inWidth.
 	* @param outHeight Should be &gt;= inHeight.
 	*/
-void Image::Untrim(double* output, size_t outWidth, size_t outHeight, const double* input, size_t inWidth, size_t inHeight)
+template<typename NumT>
+void ImageT<NumT>::Untrim(NumT* output, size_t outWidth, size_t outHeight, const NumT* input, size_t inWidth, size_t inHeight)
 {
 	size_t startX = (outWidth - inWidth) / 2;
 	size_t endX = (outWidth + inWidth) / 2;
@@ -85,95 +98,174 @@ void Image::Untrim(double* output, size_t outWidth, size_t outHeight, const doub
 	size_t endY = (outHeight + inHeight) / 2;
 	for(size_t y=0; y!=startY; ++y)
 	{
-		double* ptr = &output[y*outWidth];
+		NumT* ptr = &output[y*outWidth];
 		for(size_t x=0; x!=outWidth; ++x)
 			ptr[x] = 0.0;
 	}
 	for(size_t y=startY; y!=endY; ++y)
 	{
-		double* ptr = &output[y*outWidth];
+		NumT* ptr = &output[y*outWidth];
 		for(size_t x=0; x!=startX; ++x)
 			ptr[x] = 0.0;
-		memcpy(&output[y*outWidth + startX], &input[(y-startY)*inWidth], inWidth*sizeof(double));
+		memcpy(&output[y*outWidth + startX], &input[(y-startY)*inWidth], inWidth*sizeof(NumT));
 		for(size_t x=endX; x!=outWidth; ++x)
 			ptr[x] = 0.0;
 	}
 	for(size_t y=endY; y!=outHeight; ++y)
 	{
-		double* ptr = &output[y*outWidth];
+		NumT* ptr = &output[y*outWidth];
 		for(size_t x=0; x!=outWidth; ++x)
 			ptr[x] = 0.0;
 	}
 }
 
-double Image::Sum() const
+template<typename NumT>
+void ImageT<NumT>::MirrorQuadrant(NumT* image, size_t width, size_t height)
+{
+	const size_t
+		quadrantWidth = width/2 + 1,
+		quadrantHeight = height/2 + 1;
+	for(size_t y=0; y!=std::min(quadrantHeight, height); ++y)
+	{
+		NumT* row = &image[y*width];
+		// Reverse copy of pixels [1, width - quadrantWidth]
+		std::reverse_copy(row + 1, row + width - quadrantWidth + 1, row + quadrantWidth);
+	}
+	for(size_t y=quadrantHeight; y<height; ++y)
+		memcpy(&image[y*width], &image[(height-y)*width], width*sizeof(NumT));
+}
+
+template<typename NumT>
+size_t ImageT<NumT>::NFinite(const NumT* data, size_t size)
+{
+	size_t nFinite = 0;
+	for(const NumT* i=data; i!=data+size; ++i)
+	{
+		if(std::isfinite(*i))
+			++nFinite;
+	}
+	return nFinite;
+}
+
+template<typename NumT>
+double ImageT<NumT>::Sum(const NumT* data, size_t size)
 {
 	double sum = 0.0;
-	for(const double& v : *this)
-		sum += v;
+	for(const NumT* i=data; i!=data+size; ++i)
+	{
+		if(std::isfinite(*i))
+			sum += *i;
+	}
 	return sum;
 }
 
-double Image::Average() const
+template<typename NumT>
+double ImageT<NumT>::Average(const NumT* data, size_t size)
 {
-	return Sum() / size();
+	const size_t nFinite = NFinite(data, size);
+	if(nFinite == 0)
+		return std::numeric_limits<double>::quiet_NaN();
+	else
+		return Sum(data, size) / nFinite;
 }
 
-double Image::Min() const
+template<typename NumT>
+NumT ImageT<NumT>::Min(const NumT* data, size_t size)
 {
-	return *std::min_element(begin(), end());
+	NumT min = std::numeric_limits<NumT>::quiet_NaN();
+	for(const NumT* i=data; i!=data+size; ++i)
+	{
+		if(std::isfinite(*i) && !(*i >= min))
+			min = *i;
+	}
+	return min;
 }
 
-double Image::Max() const
+template<typename NumT>
+NumT ImageT<NumT>::Max(const NumT* data, size_t size)
 {
-	return *std::max_element(begin(), end());
+	NumT max = std::numeric_limits<NumT>::quiet_NaN();
+	for(const NumT* i=data; i!=data+size; ++i)
+	{
+		if(std::isfinite(*i) && !(*i <= max))
+			max = *i;
+	}
+	return max;
 }
 
-double Image::median_with_copy(const double* data, size_t size, ao::uvector<double>& copy)
+template<typename NumT>
+NumT ImageT<NumT>::RMS(const NumT* data, size_t size)
 {
-	copy.reserve(size);
-	for(const double* i=data ; i!=data+size; ++i)
+	double sum = 0.0;
+	size_t nFinite = 0;
+	for(const NumT* i=data; i!=data+size; ++i)
 	{
 		if(std::isfinite(*i))
-			copy.push_back(*i);
+		{
+			sum += double(*i) * *i;
+			++nFinite;
+		}
 	}
-	if(copy.empty())
+	if(nFinite == 0)
+		return std::numeric_limits<NumT>::quiet_NaN();
+	else
+		return std::sqrt(sum / nFinite);
+}
+
+template<typename NumT>
+NumT ImageT<NumT>::median_in_scratch(const NumT* data, size_t size, NumT* scratch, size_t& nFinite)
+{
+	nFinite = 0;
+	for(const NumT* i=data ; i!=data+size; ++i)
+	{
+		if(std::isfinite(*i))
+		{
+			scratch[nFinite] = *i;
+			++nFinite;
+		}
+	}
+	if(nFinite == 0)
 		return 0.0;
 	else {
-		bool even = (copy.size()%2) == 0;
-		ao::uvector<double>::iterator mid = copy.begin()+(copy.size()-1)/2;
-		std::nth_element(copy.begin(), mid, copy.end());
-		double median = *mid;
+		bool even = (nFinite%2) == 0;
+		NumT* mid = scratch+(nFinite-1)/2;
+		std::nth_element(scratch, mid, scratch+nFinite);
+		NumT median = *mid;
 		if(even)
 		{
-			std::nth_element(mid, mid+1, copy.end());
+			std::nth_element(mid, mid+1, scratch+nFinite);
 			median = (median + *(mid+1)) * 0.5;
 		}
 		return median;
 	}
 }
 
-double Image::MAD(const double* data, size_t size)
+template<typename NumT>
+NumT ImageT<NumT>::MAD(const NumT* data, size_t size, NumT* scratch)
 {
-	ao::uvector<double> copy;
-	double median = median_with_copy(data, size, copy);
-	if(copy.empty())
+	size_t nFinite;
+	NumT median = median_in_scratch(data, size, scratch, nFinite);
+	if(nFinite == 0)
 		return 0.0;
 		
 	// Replace all values by the difference from the mean
-	ao::uvector<double>::iterator mid = copy.begin()+(copy.size()-1)/2;
-	for(ao::uvector<double>::iterator i=copy.begin(); i!=mid+1; ++i)
+	NumT* mid = scratch+(nFinite-1)/2;
+	NumT* end = scratch+nFinite;
+	for(NumT* i=scratch; i!=mid+1; ++i)
 		*i = median - *i;
-	for(ao::uvector<double>::iterator i=mid+1; i!=copy.end(); ++i)
+	for(NumT* i=mid+1; i!=end; ++i)
 		*i = *i - median;
 	
-	std::nth_element(copy.begin(), mid, copy.end());
+	std::nth_element(scratch, mid, end);
 	median = *mid;
-	bool even = (copy.size()%2) == 0;
+	bool even = (nFinite%2) == 0;
 	if(even)
 	{
-		std::nth_element(mid, mid+1, copy.end());
+		std::nth_element(mid, mid+1, end);
 		median = (median + *(mid+1)) * 0.5;
 	}
 	return median;
 }
+
+template class ImageT<double>;
+template class ImageT<float>;
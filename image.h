@@ -6,27 +6,34 @@
 
 #include "uvector.h"
 
-class Image
+/**
+ * A two-dimensional image with pixels of type NumT. It is instantiated
+ * for float and double; see the Image and ImageF typedefs below. Sums are
+ * accumulated in double precision for both.
+ */
+template<typename NumT>
+class ImageT
 {
 public:
-	typedef double* iterator;
-	typedef const double* const_iterator;
+	typedef NumT value_type;
+	typedef NumT* iterator;
+	typedef const NumT* const_iterator;
 	
-	Image() : _data(), _width(0), _height(0) { }
-	Image(size_t width, size_t height);
-	Image(size_t width, size_t height, double initialValue);
+	ImageT() : _data(), _width(0), _height(0) { }
+	ImageT(size_t width, size_t height);
+	ImageT(size_t width, size_t height, NumT initialValue);
 	
-	~Image();
+	~ImageT();
 	
-	Image(const Image&) = default;
-	Image& operator=(const Image&) = default;
-	Image& operator=(double value);
+	ImageT(const ImageT&) = default;
+	ImageT& operator=(const ImageT&) = default;
+	ImageT& operator=(NumT value);
 	
-	Image(Image&& source) = default;
-	Image& operator=(Image&& source) = default;
+	ImageT(ImageT&& source) = default;
+	ImageT& operator=(ImageT&& source) = default;
 	
-	double* data() { return _data.data(); }
-	const double* data() const { return _data.data(); }
+	NumT* data() { return _data.data(); }
+	const NumT* data() const { return _data.data(); }
 	
 	size_t Width() const { return _width; }
 	size_t Height() const { return _height; }
@@ -39,14 +46,14 @@ public:
 	iterator end() { return _data.end(); }
 	const_iterator end() const { return _data.end(); }
 	
-	const double& operator[](size_t index) const { return _data[index]; }
-	double& operator[](size_t index) { return _data[index]; }
+	const NumT& operator[](size_t index) const { return _data[index]; }
+	NumT& operator[](size_t index) { return _data[index]; }
 	
 	
-	Image& operator*=(double factor);
-	Image& operator*=(const Image& other);
-	Image& operator/=(double factor)
-	{ return (*this) *= 1.0/factor; }
+	ImageT& operator*=(NumT factor);
+	ImageT& operator*=(const ImageT& other);
+	ImageT& operator/=(NumT factor)
+	{ return (*this) *= NumT(1.0)/factor; }
 	
 	void reset();
 	
@@ -54,7 +61,7 @@ public:
 	 * @param outWidth Should be &lt;= inWidth.
 	 * @param outHeight Should be &lt;= inHeight.
 	 */
-	static void Trim(double* output, size_t outWidth, size_t outHeight, const double* input, size_t inWidth, size_t inHeight);
+	static void Trim(NumT* output, size_t outWidth, size_t outHeight, const NumT* input, size_t inWidth, size_t inHeight);
 	
 	template<typename T>
 	static void TrimBox(T* output, size_t x1, size_t y1, size_t boxWidth, size_t boxHeight, const T* input, size_t inWidth, size_t inHeight);
@@ -63,47 +70,93 @@ public:
 	 * @param outWidth Should be &gt;= inWidth.
 	 * @param outHeight Should be &gt;= inHeight.
 	 */
-	static void Untrim(double* output, size_t outWidth, size_t outHeight, const double* input, size_t inWidth, size_t inHeight);
+	static void Untrim(NumT* output, size_t outWidth, size_t outHeight, const NumT* input, size_t inWidth, size_t inHeight);
+	
+	/**
+	 * Complete an image that is mirror symmetric around pixel (width/2, height/2)
+	 * from its first quadrant. On input, the pixels with x &lt;= width/2 and
+	 * y &lt;= height/2 should be set. The other pixels are copied from
+	 * (width - x, height - y); column and row 0 have no counterpart and are part of the
+	 * quadrant. This holds for odd and even sizes, because ImageCoordinates::XYToLM()
+	 * gives l(width - x) = -l(x) and m(height - y) = -m(y) in both cases.
+	 */
+	static void MirrorQuadrant(NumT* image, size_t width, size_t height);
 	
-	static double Median(const double* data, size_t size)
+	static NumT Median(const NumT* data, size_t size)
 	{
-		ao::uvector<double> copy;
-		return median_with_copy(data, size, copy);
+		ao::uvector<NumT> scratch(size);
+		return Median(data, size, scratch.data());
 	}
 	
-	static double MAD(const double* data, size_t size);
+	/**
+	 * Same as above, with a buffer of @p size elements provided by the caller
+	 * in which the finite values are sorted, so that nothing is allocated.
+	 */
+	static NumT Median(const NumT* data, size_t size, NumT* scratch)
+	{
+		size_t nFinite;
+		return median_in_scratch(data, size, scratch, nFinite);
+	}
 	
-	double Sum() const;
-	double Average() const;
+	static NumT MAD(const NumT* data, size_t size)
+	{
+		ao::uvector<NumT> scratch(size);
+		return MAD(data, size, scratch.data());
+	}
 	
-	double Min() const;
-	double Max() const;
+	static NumT MAD(const NumT* data, size_t size, NumT* scratch);
 	
-	double StdDevFromMAD() const { return StdDevFromMAD(_data.data(), _data.size()); }
-	static double StdDevFromMAD(const double* data, size_t size)
+	/**
+	 * Number of finite values. Corrected images have NaNs where the beam is
+	 * small, so the statistics below, like the median, skip values that are
+	 * not finite.
+	 */
+	size_t NFinite() const { return NFinite(_data.data(), _data.size()); }
+	static size_t NFinite(const NumT* data, size_t size);
+	
+	/** Sum of the finite values, accumulated and returned in double precision. */
+	double Sum() const { return Sum(_data.data(), _data.size()); }
+	static double Sum(const NumT* data, size_t size);
+	/** Mean of the finite values, in double precision, or NaN if there are none. */
+	double Average() const { return Average(_data.data(), _data.size()); }
+	static double Average(const NumT* data, size_t size);
+	
+	/** Smallest finite value, or NaN if there are none. Same for Max(). */
+	NumT Min() const { return Min(_data.data(), _data.size()); }
+	static NumT Min(const NumT* data, size_t size);
+	NumT Max() const { return Max(_data.data(), _data.size()); }
+	static NumT Max(const NumT* data, size_t size);
+	
+	NumT StdDevFromMAD() const { return StdDevFromMAD(_data.data(), _data.size()); }
+	static NumT StdDevFromMAD(const NumT* data, size_t size)
 	{
-		// norminv(0.75) x MAD
-		return 1.48260221850560 * MAD(data, size);
+		ao::uvector<NumT> scratch(size);
+		return StdDevFromMAD(data, size, scratch.data());
 	}
 	
-	static double RMS(const double* data, size_t size)
+	/** Same as above, with a scratch buffer as for Median(). */
+	static NumT StdDevFromMAD(const NumT* data, size_t size, NumT* scratch)
 	{
-		double sum = 0.0;
-		for(size_t i=0; i!=size; ++i)
-			sum += data[i]*data[i];
-		return sqrt(sum/size);
+		// norminv(0.75) x MAD
+		return 1.48260221850560 * MAD(data, size, scratch);
 	}
 	
+	/** Root mean square of the finite values, or NaN if there are none. */
+	static NumT RMS(const NumT* data, size_t size);
+	
 	void Negate()
 	{
-		for(double& d : *this)
+		for(NumT& d : *this)
 			d = -d;
 	}
 private:
-	ao::uvector<double> _data;
+	ao::uvector<NumT> _data;
 	size_t _width, _height;
 	
-	static double median_with_copy(const double* data, size_t size, ao::uvector<double>& copy);
+	static NumT median_in_scratch(const NumT* data, size_t size, NumT* scratch, size_t& nFinite);
 };
 
+typedef ImageT<double> Image;
+typedef ImageT<float> ImageF;
+
 #endif
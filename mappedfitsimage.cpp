@@ -0,0 +1,117 @@
+#include "mappedfitsimage.h"
+
+#include "fitsreader.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	template<typename Word>
+	inline Word byteSwap(Word word);
+	
+	template<>
+	inline uint32_t byteSwap(uint32_t word) { return __builtin_bswap32(word); }
+	
+	template<>
+	inline uint64_t byteSwap(uint64_t word) { return __builtin_bswap64(word); }
+	
+	/**
+	 * Convert big-endian values of type Source to Dest. The memcpy calls only
+	 * reinterpret the bytes, and are optimized away.
+	 */
+	template<typename Source, typename Word, typename Dest>
+	void convertBigEndian(const unsigned char* __restrict__ source, Dest* __restrict__ dest, size_t n)
+	{
+		static_assert(sizeof(Source) == sizeof(Word), "Word should have the size of Source");
+		for(size_t i=0; i!=n; ++i)
+		{
+			Word word;
+			memcpy(&word, source + i*sizeof(Word), sizeof(Word));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+			word = byteSwap(word);
+#endif
+			Source value;
+			memcpy(&value, &word, sizeof(Word));
+			dest[i] = value;
+		}
+	}
+}
+
+MappedFitsImage::MappedFitsImage(FitsReader& reader) :
+	_reader(reader),
+	_width(reader.ImageWidth()),
+	_height(reader.ImageHeight()),
+	_nImages(reader.NImages()),
+	_bitPix(0),
+	_mapping(nullptr),
+	_mappingSize(0),
+	_data(nullptr)
+{
+	int status = 0;
+	fits_get_img_type(reader.FitsHandle(), &_bitPix, &status);
+	checkStatus(status, reader.Filename());
+	if(_bitPix != FLOAT_IMG && _bitPix != DOUBLE_IMG)
+		return;
+	if(fits_is_compressed_image(reader.FitsHandle(), &status))
+		return;
+	checkStatus(status, reader.Filename());
+	LONGLONG headerStart, dataStart, dataEnd;
+	fits_get_hduaddrll(reader.FitsHandle(), &headerStart, &dataStart, &dataEnd, &status);
+	checkStatus(status, reader.Filename());
+	
+	// Anything that can not be mapped, like a gzipped file or a name with
+	// cfitsio's extended syntax, falls back to reading through cfitsio. A plain
+	// FITS file starts with the SIMPLE keyword.
+	const size_t dataSize = _width * _height * _nImages * bytesPerPixel();
+	int fd = open(reader.Filename().c_str(), O_RDONLY);
+	if(fd < 0)
+		return;
+	struct stat fileStat;
+	char keyword[6];
+	if(fstat(fd, &fileStat) != 0 ||
+		size_t(fileStat.st_size) < size_t(dataStart) + dataSize ||
+		pread(fd, keyword, sizeof(keyword), 0) != sizeof(keyword) ||
+		memcmp(keyword, "SIMPLE", sizeof(keyword)) != 0)
+	{
+		close(fd);
+		return;
+	}
+	// The mapping has to start at a page boundary
+	const size_t
+		pageSize = sysconf(_SC_PAGESIZE),
+		mappingStart = (size_t(dataStart) / pageSize) * pageSize;
+	const size_t mappingSize = size_t(dataStart) - mappingStart + dataSize;
+	void* mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, mappingStart);
+	close(fd);
+	if(mapping == MAP_FAILED)
+		return;
+	_mapping = mapping;
+	_mappingSize = mappingSize;
+	_data = static_cast<const unsigned char*>(mapping) + (size_t(dataStart) - mappingStart);
+}
+
+MappedFitsImage::~MappedFitsImage()
+{
+	if(_mapping != nullptr)
+		munmap(_mapping, _mappingSize);
+}
+
+template void MappedFitsImage::ReadRows(float* image, size_t rowStart, size_t nRows, size_t index);
+template void MappedFitsImage::ReadRows(double* image, size_t rowStart, size_t nRows, size_t index);
+
+template<typename NumType>
+void MappedFitsImage::ReadRows(NumType* image, size_t rowStart, size_t nRows, size_t index)
+{
+	checkRows(rowStart, nRows, index);
+	if(!IsMapped())
+		_reader.ReadRows(image, rowStart, nRows, index);
+	else if(_bitPix == DOUBLE_IMG)
+		convertBigEndian<double, uint64_t>(RawRows(rowStart, index), image, _width * nRows);
+	else
+		convertBigEndian<float, uint32_t>(RawRows(rowStart, index), image, _width * nRows);
+}
@@ -0,0 +1,83 @@
+#ifndef MAPPED_FITS_IMAGE_H
+#define MAPPED_FITS_IMAGE_H
+
+#include "fitsiochecker.h"
+
+#include <cstddef>
+#include <stdexcept>
+
+/**
+ * Reads the pixels of an uncompressed floating point (BITPIX -32 or -64) FITS
+ * image directly from a memory mapping of its data unit, instead of copying
+ * them through the buffers of cfitsio. The pixels in the file are big endian;
+ * rows are converted only when they are read, with loops that the compiler
+ * can vectorize. Consumers that can handle big-endian data themselves can use
+ * the mapped data directly with RawRows().
+ *
+ * When the image can not be mapped, e.g. because it is compressed, has an
+ * integer type or is opened with cfitsio's extended filename syntax, all
+ * reads go through the FitsReader instead. Reading a mapped image is thread
+ * safe; reading through the fallback is not.
+ */
+class MappedFitsImage : private FitsIOChecker
+{
+public:
+	/**
+	 * @param reader Opened image. It is used for the geometry, and for reading when
+	 * the image can not be mapped, so it should outlive this object.
+	 */
+	explicit MappedFitsImage(class FitsReader& reader);
+	~MappedFitsImage();
+	
+	MappedFitsImage(const MappedFitsImage&) = delete;
+	MappedFitsImage& operator=(const MappedFitsImage&) = delete;
+	
+	/** Whether the data unit is mapped. If not, reads go through cfitsio. */
+	bool IsMapped() const { return _data != nullptr; }
+	
+	/** BITPIX of the image, which is -32 or -64 when the image is mapped. */
+	int BitPix() const { return _bitPix; }
+	
+	/**
+	 * Pointer to the big-endian pixels in the file, starting at a given row of a
+	 * plane. Only valid when IsMapped(). Throws when the row or plane lies
+	 * outside the image.
+	 */
+	const unsigned char* RawRows(size_t rowStart, size_t index) const
+	{
+		checkRows(rowStart, 0, index);
+		return _data + ((index * _height + rowStart) * _width) * bytesPerPixel();
+	}
+	
+	/**
+	 * Read a block of consecutive full rows from one plane, converted to the
+	 * byte order and type of the host. Gives the same values as
+	 * FitsReader::ReadRows().
+	 */
+	template<typename NumType>
+	void ReadRows(NumType* image, size_t rowStart, size_t nRows, size_t index=0);
+	
+	template<typename NumType>
+	void ReadIndex(NumType* image, size_t index)
+	{
+		ReadRows(image, 0, _height, index);
+	}
+	
+private:
+	size_t bytesPerPixel() const { return _bitPix == -64 ? 8 : 4; }
+	
+	void checkRows(size_t rowStart, size_t nRows, size_t index) const
+	{
+		if(rowStart + nRows > _height || index >= _nImages)
+			throw std::runtime_error("Rows to read lie outside the image");
+	}
+	
+	class FitsReader& _reader;
+	size_t _width, _height, _nImages;
+	int _bitPix;
+	void* _mapping;
+	size_t _mappingSize;
+	const unsigned char* _data;
+};
+
+#endif
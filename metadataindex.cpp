@@ -0,0 +1,261 @@
+#include "metadataindex.h"
+
+#include "fitsreader.h"
+#include "parallelfor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	const char* const Columns =
+		"filename,file_size,mtime_ns,width,height,planes,frequency_hz,bandwidth_hz,date_obs_mjd,"
+		"ra_rad,dec_rad,pixel_size_x_rad,pixel_size_y_rad,has_beam,beam_major_rad,beam_minor_rad,beam_pa_rad,"
+		"polarization,telescope,object";
+	
+	void writeString(std::ostream& stream, const std::string& str)
+	{
+		stream << '"';
+		for(char c : str)
+		{
+			if(c == '"')
+				stream << "\"\"";
+			else
+				stream << c;
+		}
+		stream << '"';
+	}
+	
+	/**
+	 * Split a CSV line into fields. Fields can be quoted, in which case they can
+	 * contain commas and doubled quotes.
+	 */
+	std::vector<std::string> splitLine(const std::string& line)
+	{
+		std::vector<std::string> fields(1);
+		bool quoted = false;
+		for(size_t i=0; i!=line.size(); ++i)
+		{
+			const char c = line[i];
+			if(quoted)
+			{
+				if(c == '"' && i+1 != line.size() && line[i+1] == '"')
+				{
+					fields.back() += '"';
+					++i;
+				}
+				else if(c == '"')
+					quoted = false;
+				else
+					fields.back() += c;
+			}
+			else if(c == '"')
+				quoted = true;
+			else if(c == ',')
+				fields.emplace_back();
+			else
+				fields.back() += c;
+		}
+		return fields;
+	}
+	
+	template<typename T>
+	T parseField(const std::string& field)
+	{
+		std::istringstream stream(field);
+		T value;
+		if(!(stream >> value))
+			throw std::runtime_error("Invalid value in catalogue: " + field);
+		return value;
+	}
+	
+	PolarizationEnum parsePolarization(const std::string& field)
+	{
+		// TypeToShortString() gives values that ParseString() does not accept
+		if(field == "instr")
+			return Polarization::Instrumental;
+		else if(field.empty())
+			return Polarization::StokesI;
+		else
+			return Polarization::ParseString(field);
+	}
+}
+
+void MetadataIndex::Read(const std::string& filename)
+{
+	_entries.clear();
+	std::ifstream file(filename);
+	if(!file)
+		return;
+	std::string line;
+	if(!std::getline(file, line) || line != Columns)
+	{
+		std::cerr << "Catalogue " << filename << " has a different format, all files will be scanned.\n";
+		return;
+	}
+	while(std::getline(file, line))
+	{
+		const std::vector<std::string> fields = splitLine(line);
+		if(fields.size() != 20)
+			throw std::runtime_error("Invalid line in catalogue " + filename + ": " + line);
+		MetadataIndexEntry entry;
+		entry.filename = fields[0];
+		entry.fileSize = parseField<uint64_t>(fields[1]);
+		entry.modificationTime = parseField<int64_t>(fields[2]);
+		entry.width = parseField<size_t>(fields[3]);
+		entry.height = parseField<size_t>(fields[4]);
+		entry.nImages = parseField<size_t>(fields[5]);
+		entry.frequency = parseField<double>(fields[6]);
+		entry.bandwidth = parseField<double>(fields[7]);
+		entry.dateObs = parseField<double>(fields[8]);
+		entry.phaseCentreRA = parseField<double>(fields[9]);
+		entry.phaseCentreDec = parseField<double>(fields[10]);
+		entry.pixelSizeX = parseField<double>(fields[11]);
+		entry.pixelSizeY = parseField<double>(fields[12]);
+		entry.hasBeam = parseField<int>(fields[13]) != 0;
+		entry.beamMajorAxis = parseField<double>(fields[14]);
+		entry.beamMinorAxis = parseField<double>(fields[15]);
+		entry.beamPositionAngle = parseField<double>(fields[16]);
+		entry.polarization = parsePolarization(fields[17]);
+		entry.telescopeName = fields[18];
+		entry.objectName = fields[19];
+		_entries.push_back(entry);
+	}
+	std::sort(_entries.begin(), _entries.end(),
+		[](const MetadataIndexEntry& a, const MetadataIndexEntry& b) { return a.filename < b.filename; });
+}
+
+void MetadataIndex::Write(const std::string& filename) const
+{
+	std::ostringstream tmpName;
+	tmpName << filename << ".tmp" << getpid();
+	{
+		std::ofstream file(tmpName.str());
+		// Enough digits to read back the exact same doubles
+		file.precision(std::numeric_limits<double>::max_digits10);
+		file << Columns << '\n';
+		for(const MetadataIndexEntry& entry : _entries)
+		{
+			writeString(file, entry.filename);
+			file << ',' << entry.fileSize << ',' << entry.modificationTime
+				<< ',' << entry.width << ',' << entry.height << ',' << entry.nImages
+				<< ',' << entry.frequency << ',' << entry.bandwidth << ',' << entry.dateObs
+				<< ',' << entry.phaseCentreRA << ',' << entry.phaseCentreDec
+				<< ',' << entry.pixelSizeX << ',' << entry.pixelSizeY
+				<< ',' << (entry.hasBeam ? 1 : 0)
+				<< ',' << entry.beamMajorAxis << ',' << entry.beamMinorAxis << ',' << entry.beamPositionAngle
+				<< ',' << Polarization::TypeToShortString(entry.polarization) << ',';
+			writeString(file, entry.telescopeName);
+			file << ',';
+			writeString(file, entry.objectName);
+			file << '\n';
+		}
+		if(!file)
+			throw std::runtime_error("Could not write catalogue " + tmpName.str());
+	}
+	if(std::rename(tmpName.str().c_str(), filename.c_str()) != 0)
+	{
+		std::remove(tmpName.str().c_str());
+		throw std::runtime_error("Could not rename catalogue to " + filename);
+	}
+}
+
+size_t MetadataIndex::Update(const std::vector<std::string>& filenames, size_t nThreads)
+{
+	std::map<std::string, MetadataIndexEntry> previous;
+	for(MetadataIndexEntry& entry : _entries)
+		previous.insert(std::make_pair(entry.filename, std::move(entry)));
+	_entries.clear();
+	
+	std::vector<std::string> toScan;
+	for(const std::string& filename : filenames)
+	{
+		uint64_t fileSize;
+		int64_t modificationTime;
+		std::map<std::string, MetadataIndexEntry>::iterator entry = previous.find(filename);
+		if(entry != previous.end() &&
+			getFileStatus(filename, fileSize, modificationTime) &&
+			fileSize == entry->second.fileSize && modificationTime == entry->second.modificationTime)
+		{
+			_entries.push_back(std::move(entry->second));
+			previous.erase(entry);
+		}
+		else {
+			toScan.push_back(filename);
+		}
+	}
+	
+	std::vector<MetadataIndexEntry> scanned(toScan.size());
+	std::vector<bool> isScanned(toScan.size(), false);
+	std::mutex mutex;
+	ParallelFor(nThreads).Run(0, toScan.size(), [&](size_t index, size_t)
+	{
+		try {
+			scanned[index] = Scan(toScan[index]);
+			std::lock_guard<std::mutex> lock(mutex);
+			isScanned[index] = true;
+		} catch(std::exception& e) {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::cerr << "Skipping " << toScan[index] << ": " << e.what() << '\n';
+		}
+	});
+	for(size_t i=0; i!=toScan.size(); ++i)
+	{
+		if(isScanned[i])
+			_entries.push_back(std::move(scanned[i]));
+	}
+	
+	std::sort(_entries.begin(), _entries.end(),
+		[](const MetadataIndexEntry& a, const MetadataIndexEntry& b) { return a.filename < b.filename; });
+	_entries.erase(std::unique(_entries.begin(), _entries.end(),
+		[](const MetadataIndexEntry& a, const MetadataIndexEntry& b) { return a.filename == b.filename; }), _entries.end());
+	return toScan.size();
+}
+
+MetadataIndexEntry MetadataIndex::Scan(const std::string& filename)
+{
+	MetadataIndexEntry entry;
+	entry.filename = filename;
+	// The status is taken before reading, so that a file that changes while
+	// it is read is scanned again in the next update.
+	if(!getFileStatus(filename, entry.fileSize, entry.modificationTime))
+		throw std::runtime_error("Could not get status of file");
+	FitsReader reader(filename, false, true);
+	entry.width = reader.ImageWidth();
+	entry.height = reader.ImageHeight();
+	entry.nImages = reader.NImages();
+	entry.frequency = reader.Frequency();
+	entry.bandwidth = reader.Bandwidth();
+	entry.dateObs = reader.DateObs();
+	entry.phaseCentreRA = reader.PhaseCentreRA();
+	entry.phaseCentreDec = reader.PhaseCentreDec();
+	entry.pixelSizeX = reader.PixelSizeX();
+	entry.pixelSizeY = reader.PixelSizeY();
+	entry.hasBeam = reader.HasBeam();
+	entry.beamMajorAxis = reader.BeamMajorAxisRad();
+	entry.beamMinorAxis = reader.BeamMinorAxisRad();
+	entry.beamPositionAngle = reader.BeamPositionAngle();
+	entry.polarization = reader.Polarization();
+	entry.telescopeName = reader.TelescopeName();
+	entry.objectName = reader.ObjectName();
+	return entry;
+}
+
+bool MetadataIndex::getFileStatus(const std::string& filename, uint64_t& fileSize, int64_t& modificationTime)
+{
+	struct stat fileStat;
+	if(stat(filename.c_str(), &fileStat) != 0)
+		return false;
+	fileSize = fileStat.st_size;
+	modificationTime = int64_t(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec;
+	return true;
+}
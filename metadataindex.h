@@ -0,0 +1,76 @@
+#ifndef METADATA_INDEX_H
+#define METADATA_INDEX_H
+
+#include "polarization.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * The metadata of one image in a MetadataIndex. Units are the same as those
+ * of FitsReader: radians, Hz and MJD.
+ */
+struct MetadataIndexEntry
+{
+	std::string filename;
+	/** File size in bytes and modification time in nanoseconds, to detect changes. */
+	uint64_t fileSize;
+	int64_t modificationTime;
+	
+	size_t width, height, nImages;
+	double frequency, bandwidth, dateObs;
+	double phaseCentreRA, phaseCentreDec;
+	double pixelSizeX, pixelSizeY;
+	bool hasBeam;
+	double beamMajorAxis, beamMinorAxis, beamPositionAngle;
+	PolarizationEnum polarization;
+	std::string telescopeName, objectName;
+};
+
+/**
+ * A catalogue with the header metadata of a collection of FITS images, used
+ * to select images by frequency, date, pointing or beam without opening them
+ * all. The catalogue is stored as a CSV file. Headers are read in parallel,
+ * and on an update only files of which the size or modification time has
+ * changed are read again.
+ */
+class MetadataIndex
+{
+public:
+	/**
+	 * Load a catalogue that was written earlier with Write(). A missing file
+	 * gives an empty catalogue.
+	 */
+	void Read(const std::string& filename);
+	
+	/**
+	 * Write the catalogue. It is written under a temporary name and renamed
+	 * afterwards, so that an interrupted run does not leave a partial catalogue.
+	 */
+	void Write(const std::string& filename) const;
+	
+	/**
+	 * Make the catalogue hold exactly the given files. Files that are new or
+	 * that have changed since they were cataloged are scanned with nThreads
+	 * threads. Files that can not be read are reported on stderr and left out.
+	 * @returns Number of files that were scanned.
+	 */
+	size_t Update(const std::vector<std::string>& filenames, size_t nThreads);
+	
+	const std::vector<MetadataIndexEntry>& Entries() const { return _entries; }
+	
+	/**
+	 * Read the metadata of a single file.
+	 */
+	static MetadataIndexEntry Scan(const std::string& filename);
+	
+private:
+	static bool getFileStatus(const std::string& filename, uint64_t& fileSize, int64_t& modificationTime);
+	
+	/** Sorted by filename */
+	std::vector<MetadataIndexEntry> _entries;
+};
+
+#endif
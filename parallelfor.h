@@ -0,0 +1,77 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Executes a loop over a range of indices with a fixed number of threads.
+ * Indices are handed out one at a time, so the work is balanced even when
+ * iterations do not take equally long. An exception thrown by one of the
+ * iterations is rethrown by Run() once all threads have finished.
+ */
+class ParallelFor
+{
+public:
+	explicit ParallelFor(size_t nThreads) :
+		_nThreads(nThreads == 0 ? 1 : nThreads)
+	{ }
+
+	/**
+	 * Call function(index, threadIndex) for every index in [start, end).
+	 * threadIndex is in [0, NThreads()) and can be used to select
+	 * per-thread scratch buffers.
+	 */
+	void Run(size_t start, size_t end, const std::function<void(size_t, size_t)>& function)
+	{
+		std::atomic<size_t> next(start);
+		std::exception_ptr exception;
+		std::mutex exceptionMutex;
+		auto loop = [&](size_t threadIndex)
+		{
+			try {
+				size_t index;
+				while((index = next.fetch_add(1)) < end)
+					function(index, threadIndex);
+			} catch(...) {
+				std::lock_guard<std::mutex> lock(exceptionMutex);
+				if(!exception)
+					exception = std::current_exception();
+				next = end;
+			}
+		};
+
+		size_t nThreads = std::min(_nThreads, end > start ? end - start : 1);
+		std::vector<std::thread> threads;
+		threads.reserve(nThreads - 1);
+		for(size_t t=1; t!=nThreads; ++t)
+			threads.emplace_back(loop, t);
+		loop(0);
+		for(std::thread& thread : threads)
+			thread.join();
+		if(exception)
+			std::rethrow_exception(exception);
+	}
+
+	size_t NThreads() const { return _nThreads; }
+
+	/**
+	 * Number of threads that the hardware can run concurrently, or 1 if
+	 * this can not be determined.
+	 */
+	static size_t HardwareThreads()
+	{
+		size_t n = std::thread::hardware_concurrency();
+		return n == 0 ? 1 : n;
+	}
+
+private:
+	size_t _nThreads;
+};
+
+#endif
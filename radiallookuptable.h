@@ -0,0 +1,109 @@
+#ifndef RADIAL_LOOKUP_TABLE_H
+#define RADIAL_LOOKUP_TABLE_H
+
+#include "uvector.h"
+
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+
+/**
+ * Lookup table for a function that only depends on the distance to a
+ * centre, such as a primary beam that depends on the angular distance
+ * to the pointing centre. The function is sampled once on a regular
+ * grid that is made fine enough for linear interpolation to stay within
+ * a given tolerance, after which evaluating a pixel is a table lookup.
+ */
+class RadialLookupTable
+{
+public:
+	/**
+	 * Construct the table.
+	 * @param profile The function to tabulate, callable as double(double radius).
+	 * @param maxRadius Largest radius that is tabulated. Radii outside
+	 * [0, maxRadius] are evaluated by calling the profile directly.
+	 * @param tolerance Maximum absolute interpolation error. The grid is refined
+	 * until the error measured at several points inside every interval is
+	 * below this value.
+	 */
+	template<typename Profile>
+	RadialLookupTable(Profile profile, double maxRadius, double tolerance) :
+		_profile(profile)
+	{
+		if(!(maxRadius > 0.0) || !(tolerance > 0.0))
+			throw std::runtime_error("Invalid radius or tolerance for radial lookup table");
+		size_t nIntervals = 64;
+		do {
+			if(nIntervals > MaxIntervals)
+				throw std::runtime_error("Radial lookup table can not reach the requested tolerance");
+			sample(profile, maxRadius, nIntervals);
+			nIntervals *= 2;
+		} while(_maxError > tolerance);
+	}
+	
+	double operator()(double radius) const
+	{
+		const double position = radius * _inverseStep;
+		// This condition is also false for NaN
+		if(position >= 0.0 && position < _tableLimit)
+		{
+			const size_t index = size_t(position);
+			const double fraction = position - double(index);
+			return _table[index] + fraction * (_table[index+1] - _table[index]);
+		}
+		else {
+			return _profile(radius);
+		}
+	}
+	
+	void EvaluateRow(const double* radius, double* values, size_t n) const
+	{
+		for(size_t i=0; i!=n; ++i)
+			values[i] = (*this)(radius[i]);
+	}
+	
+	/** Number of samples in the table. */
+	size_t Size() const { return _table.size(); }
+	
+	/** Distance between two samples. */
+	double Step() const { return 1.0 / _inverseStep; }
+	
+	/** Largest interpolation error that was measured while constructing the table. */
+	double MaxError() const { return _maxError; }
+	
+private:
+	static constexpr size_t MaxIntervals = size_t(1) << 24;
+	
+	template<typename Profile>
+	void sample(Profile& profile, double maxRadius, size_t nIntervals)
+	{
+		const double step = maxRadius / nIntervals;
+		_table.resize(nIntervals + 1);
+		for(size_t i=0; i!=nIntervals+1; ++i)
+			_table[i] = profile(i * step);
+		_inverseStep = 1.0 / step;
+		_tableLimit = double(nIntervals);
+		
+		_maxError = 0.0;
+		for(size_t i=0; i!=nIntervals; ++i)
+		{
+			for(double fraction : { 0.25, 0.5, 0.75 })
+			{
+				const double
+					radius = (i + fraction) * step,
+					error = std::fabs((*this)(radius) - profile(radius));
+				if(!std::isfinite(error))
+					_maxError = std::numeric_limits<double>::infinity();
+				else if(error > _maxError)
+					_maxError = error;
+			}
+		}
+	}
+	
+	std::function<double(double)> _profile;
+	ao::uvector<double> _table;
+	double _inverseStep, _tableLimit, _maxError;
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "../beamcorrection.h"
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * Checks that BeamCorrection gives bit-for-bit the same result as the scalar
+ * loop that applybeam used before, for every mode, for float and double, and
+ * with one and multiple threads. The input includes values around the
+ * threshold, zeros, NaNs and infinities, so that it is also checked where
+ * the NaNs end up.
+ */
+namespace {
+	size_t nFailures = 0;
+	
+	/**
+	 * The correction as applybeam did it before BeamCorrection existed.
+	 */
+	template<typename NumType>
+	void referenceCorrection(NumType* image, const NumType* beam, size_t n, BeamCorrection::Mode mode)
+	{
+		for(size_t i=0; i!=n; ++i)
+		{
+			if(std::fabs(beam[i]) < 1e-2)
+				image[i] = std::numeric_limits<NumType>::quiet_NaN();
+			else if(mode == BeamCorrection::WeightMode)
+				image[i] /= std::sqrt(beam[i]);
+			else if(mode == BeamCorrection::SquaredMode)
+				image[i] /= beam[i] * beam[i];
+			else
+				image[i] /= beam[i];
+		}
+	}
+	
+	/**
+	 * Equal bit patterns, except that any two NaNs are equal.
+	 */
+	template<typename NumType>
+	bool same(NumType a, NumType b)
+	{
+		if(std::isnan(a) || std::isnan(b))
+			return std::isnan(a) && std::isnan(b);
+		return std::memcmp(&a, &b, sizeof(NumType)) == 0;
+	}
+	
+	template<typename NumType>
+	void compare(const std::vector<NumType>& expected, const std::vector<NumType>& result,
+		const std::vector<NumType>& image, const std::vector<NumType>& beam, const std::string& description)
+	{
+		for(size_t i=0; i!=expected.size(); ++i)
+		{
+			if(!same(expected[i], result[i]))
+			{
+				std::cout << description << ": pixel " << i << " with image=" << image[i] << " and beam=" << beam[i] <<
+					" gives " << result[i] << " instead of " << expected[i] << '\n';
+				++nFailures;
+				return;
+			}
+		}
+	}
+	
+	template<typename NumType>
+	void makeInput(std::vector<NumType>& image, std::vector<NumType>& beam, size_t n)
+	{
+		const NumType
+			nan = std::numeric_limits<NumType>::quiet_NaN(),
+			inf = std::numeric_limits<NumType>::infinity(),
+			threshold = NumType(1e-2);
+		// Values that test the threshold and the handling of special values
+		const std::vector<NumType> specialBeam = {
+			threshold, -threshold,
+			std::nextafter(threshold, NumType(0)), std::nextafter(threshold, NumType(1)),
+			-std::nextafter(threshold, NumType(0)), -std::nextafter(threshold, NumType(1)),
+			NumType(0), -NumType(0), NumType(1), NumType(-1), NumType(1e-3), NumType(1e30),
+			std::numeric_limits<NumType>::denorm_min(), nan, inf, -inf
+		};
+		const std::vector<NumType> specialImage = {
+			NumType(0), -NumType(0), NumType(1), NumType(-3.5), NumType(1e30), NumType(1e-30), nan, inf, -inf
+		};
+		std::mt19937 rng(42);
+		std::uniform_real_distribution<double> beamDistribution(-1.5, 1.5), imageDistribution(-10.0, 10.0);
+		image.resize(n);
+		beam.resize(n);
+		for(size_t i=0; i!=n; ++i)
+		{
+			// Every combination of special values occurs, among random values
+			if(i < specialBeam.size() * specialImage.size())
+			{
+				beam[i] = specialBeam[i % specialBeam.size()];
+				image[i] = specialImage[i / specialBeam.size()];
+			}
+			else {
+				beam[i] = (i % 7 == 0) ? specialBeam[rng() % specialBeam.size()] : NumType(beamDistribution(rng));
+				image[i] = (i % 11 == 0) ? specialImage[rng() % specialImage.size()] : NumType(imageDistribution(rng));
+			}
+		}
+	}
+	
+	template<typename NumType>
+	void testMode(BeamCorrection::Mode mode, const std::string& typeName)
+	{
+		const std::string modeName =
+			mode == BeamCorrection::SquaredMode ? "squared" :
+			(mode == BeamCorrection::NotSquaredMode ? "not squared" : "weight");
+		// Sizes that are smaller than, equal to and not a multiple of the chunk size
+		for(size_t n : { size_t(0), size_t(1), size_t(1000), size_t(16384), size_t(100003) })
+		{
+			std::vector<NumType> image, beam;
+			makeInput(image, beam, n);
+			std::vector<NumType> expected(image);
+			referenceCorrection(expected.data(), beam.data(), n, mode);
+			for(size_t nThreads : { size_t(1), size_t(4) })
+			{
+				const std::string description = typeName + ", " + modeName + " mode, n=" + std::to_string(n) + ", " + std::to_string(nThreads) + " threads";
+				const BeamCorrection correction(mode, nThreads);
+				
+				std::vector<NumType> result(image);
+				correction.Apply(result.data(), beam.data(), n);
+				compare(expected, result, image, beam, description + ", Apply()");
+				
+				std::vector<NumType> divisor(beam);
+				correction.Prepare(divisor.data(), n);
+				result = image;
+				correction.ApplyPrepared(result.data(), divisor.data(), n);
+				compare(expected, result, image, beam, description + ", ApplyPrepared()");
+			}
+		}
+	}
+	
+	template<typename NumType>
+	void testType(const std::string& typeName)
+	{
+		testMode<NumType>(BeamCorrection::SquaredMode, typeName);
+		testMode<NumType>(BeamCorrection::NotSquaredMode, typeName);
+		testMode<NumType>(BeamCorrection::WeightMode, typeName);
+	}
+}
+
+int main()
+{
+	testType<double>("double");
+	testType<float>("float");
+	if(nFailures != 0)
+	{
+		std::cout << nFailures << " comparisons failed.\n";
+		return 1;
+	}
+	std::cout << "BeamCorrection matches the scalar loop.\n";
+	return 0;
+}
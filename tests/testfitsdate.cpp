@@ -0,0 +1,103 @@
+#include "../fitsreader.h"
+
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Checks FitsReader::ParseFitsDateToMJD() against known MJDs, and checks
+ * that malformed or impossible dates are refused.
+ */
+namespace {
+	size_t nFailures = 0;
+	
+	void checkDate(const std::string& date, double expectedMJD)
+	{
+		try {
+			const double mjd = FitsReader::ParseFitsDateToMJD(date.c_str());
+			// 1e-9 days is about 0.1 ms
+			if(std::fabs(mjd - expectedMJD) > 1e-9)
+			{
+				std::cout.precision(15);
+				std::cout << '"' << date << "\" gives MJD " << mjd << " instead of " << expectedMJD << '\n';
+				++nFailures;
+			}
+		} catch(std::exception& e) {
+			std::cout << '"' << date << "\" is refused: " << e.what() << '\n';
+			++nFailures;
+		}
+	}
+	
+	void checkInvalid(const std::string& date)
+	{
+		try {
+			const double mjd = FitsReader::ParseFitsDateToMJD(date.c_str());
+			std::cout.precision(15);
+			std::cout << '"' << date << "\" is accepted as MJD " << mjd << '\n';
+			++nFailures;
+		} catch(std::runtime_error&) {
+		}
+	}
+}
+
+int main()
+{
+	// Dates
+	checkDate("1858-11-17", 0.0);
+	checkDate("1970-01-01", 40587.0);
+	checkDate("1999-12-31", 51543.0);
+	checkDate("2000-01-01", 51544.0);
+	// With a time, with and without fractional seconds and 'Z'
+	checkDate("2000-01-01T12:00:00", 51544.5);
+	checkDate("2000-01-01T12:00:00Z", 51544.5);
+	checkDate("2013-04-01T23:59:59", 56383.99998842592);
+	checkDate("2010-06-15T06:30:15.25", 55362.27100983796);
+	checkDate("2010-06-15T06:30:15.25Z", 55362.27100983796);
+	// Leading and trailing spaces, as in a FITS value
+	checkDate("  2000-01-01T12:00:00  ", 51544.5);
+	// The old DD/MM/YY format, for 1900-1999
+	checkDate("17/11/58", 36524.0);
+	checkDate("31/12/99", 51543.0);
+	// February 29 in leap years, including a century divisible by 400
+	checkDate("2016-02-29", 57447.0);
+	checkDate("2000-02-29", 51603.0);
+	checkDate("2016-03-01", 57448.0);
+	
+	// February 29 in years that are not leap years
+	checkInvalid("2015-02-29");
+	checkInvalid("1900-02-29");
+	checkInvalid("2100-02-29");
+	checkInvalid("29/02/99");
+	// Bad month or day
+	checkInvalid("2000-00-10");
+	checkInvalid("2000-13-01");
+	checkInvalid("2000-01-00");
+	checkInvalid("2000-01-32");
+	checkInvalid("2000-04-31");
+	checkInvalid("31/13/99");
+	// Bad time
+	checkInvalid("2000-01-01T24:00:00");
+	checkInvalid("2000-01-01T12:60:00");
+	checkInvalid("2000-01-01T12:00:61");
+	checkInvalid("2000-01-01T12:00");
+	checkInvalid("2000-01-01T1:00:00");
+	// Malformed
+	checkInvalid("");
+	checkInvalid("   ");
+	checkInvalid("2000");
+	checkInvalid("2000-1-01");
+	checkInvalid("2000/01/01");
+	checkInvalid("2000-01-01X");
+	checkInvalid("2000-01-01T12:00:00ZZ");
+	checkInvalid("1/1/99");
+	checkInvalid("yesterday");
+	
+	if(nFailures != 0)
+	{
+		std::cout << nFailures << " checks failed.\n";
+		return 1;
+	}
+	std::cout << "All FITS dates are parsed correctly.\n";
+	return 0;
+}
@@ -0,0 +1,167 @@
+#include "../fitsreader.h"
+#include "../fitswriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/**
+ * Writes images with FitsWriter, reads them back with FitsReader and checks
+ * that the WCS of the extra axes survives the round trip.
+ */
+namespace {
+	size_t nFailures = 0;
+	
+	const char
+		*filename = "testfitswriter-tmp.fits",
+		*copyFilename = "testfitswriter-copy-tmp.fits";
+	
+	void checkValue(const std::string& name, double value, double expected)
+	{
+		if(std::fabs(value - expected) > 1e-9 * std::max(1.0, std::fabs(expected)))
+		{
+			std::cout.precision(15);
+			std::cout << name << " is " << value << " instead of " << expected << '\n';
+			++nFailures;
+		}
+	}
+	
+	void checkKey(FitsReader& reader, const char* key, double expected)
+	{
+		double value;
+		if(reader.ReadDoubleKeyIfExists(key, value))
+			checkValue(key, value, expected);
+		else {
+			std::cout << key << " is missing\n";
+			++nFailures;
+		}
+	}
+	
+	void checkAxis(const FitsReader& reader, size_t index, FitsReader::AxisType type, size_t size, double refPixel, double refValue, double increment)
+	{
+		if(reader.ExtraAxes().size() <= index)
+		{
+			std::cout << "Axis " << index+3 << " is missing\n";
+			++nFailures;
+			return;
+		}
+		const FitsReader::Axis& axis = reader.ExtraAxes()[index];
+		const std::string name = "Axis " + std::to_string(index+3);
+		if(axis.type != type || axis.size != size)
+		{
+			std::cout << name << " has the wrong type or size\n";
+			++nFailures;
+		}
+		checkValue(name + " reference pixel", axis.refPixel, refPixel);
+		checkValue(name + " reference value", axis.refValue, refValue);
+		checkValue(name + " increment", axis.increment, increment);
+	}
+	
+	FitsWriter makeWriter(size_t width, size_t height)
+	{
+		FitsWriter writer;
+		writer.SetImageDimensions(width, height, 0.5, 0.9, 1e-4, 1e-4);
+		writer.SetFrequency(150e6, 1e6);
+		writer.SetPolarization(Polarization::XX);
+		return writer;
+	}
+	
+	/** A single image with the default frequency and polarization axes */
+	void testDefaultDimensions()
+	{
+		const size_t width = 4, height = 3;
+		std::vector<float> image(width * height);
+		for(size_t i=0; i!=image.size(); ++i)
+			image[i] = i * 0.5;
+		makeWriter(width, height).Write(filename, image.data());
+		
+		FitsReader reader(filename);
+		checkKey(reader, "CRPIX3", 1.0);
+		checkKey(reader, "CRVAL3", 150e6);
+		checkKey(reader, "CDELT3", 1e6);
+		checkKey(reader, "CRPIX4", 1.0);
+		checkKey(reader, "CRVAL4", -5.0);
+		checkAxis(reader, 0, FitsReader::FrequencyAxis, 1, 1.0, 150e6, 1e6);
+		checkAxis(reader, 1, FitsReader::PolarizationAxis, 1, 1.0, -5.0, 1.0);
+		checkValue("Frequency", reader.Frequency(), 150e6);
+		if(reader.Polarization() != Polarization::XX)
+		{
+			std::cout << "Polarization is not XX\n";
+			++nFailures;
+		}
+		
+		std::vector<float> readImage(width * height);
+		reader.Read(readImage.data());
+		for(size_t i=0; i!=image.size(); ++i)
+			checkValue("Pixel " + std::to_string(i), readImage[i], image[i]);
+	}
+	
+	/** A cube whose axes are copied from another file, including a CRPIX that is not 1 */
+	void testCopiedDimensions()
+	{
+		const size_t width = 2, height = 2;
+		FitsWriter writer(makeWriter(width, height));
+		writer.AddExtraDimension(FitsWriter::FrequencyDimension, 3, 2.0, 151e6, 2e6);
+		writer.AddExtraDimension(FitsWriter::PolarizationDimension, 2, 1.0, -5.0, -1.0);
+		std::vector<float> image(width * height * 6);
+		for(size_t i=0; i!=image.size(); ++i)
+			image[i] = i;
+		writer.StartMulti(filename);
+		for(size_t i=0; i!=6; ++i)
+			writer.AddToMulti(&image[i * width * height]);
+		writer.FinishMulti();
+		
+		FitsReader reader(filename, true, true);
+		checkKey(reader, "CRPIX3", 2.0);
+		checkKey(reader, "CRVAL3", 151e6);
+		checkKey(reader, "CDELT3", 2e6);
+		checkAxis(reader, 0, FitsReader::FrequencyAxis, 3, 2.0, 151e6, 2e6);
+		checkAxis(reader, 1, FitsReader::PolarizationAxis, 2, 1.0, -5.0, -1.0);
+		
+		// The copy has to preserve the axes as well
+		FitsWriter copyWriter(reader);
+		copyWriter.SetExtraDimensions(reader);
+		copyWriter.StartMulti(copyFilename);
+		std::vector<float> plane(width * height);
+		for(size_t i=0; i!=reader.NImages(); ++i)
+		{
+			reader.ReadIndex(plane.data(), i);
+			copyWriter.AddToMulti(plane.data());
+		}
+		copyWriter.FinishMulti();
+		
+		FitsReader copyReader(copyFilename, true, true);
+		checkAxis(copyReader, 0, FitsReader::FrequencyAxis, 3, 2.0, 151e6, 2e6);
+		checkAxis(copyReader, 1, FitsReader::PolarizationAxis, 2, 1.0, -5.0, -1.0);
+		std::vector<float> readImage(image.size());
+		for(size_t i=0; i!=copyReader.NImages(); ++i)
+			copyReader.ReadIndex(&readImage[i * width * height], i);
+		for(size_t i=0; i!=image.size(); ++i)
+			checkValue("Pixel " + std::to_string(i), readImage[i], image[i]);
+	}
+}
+
+int main()
+{
+	try {
+		testDefaultDimensions();
+		testCopiedDimensions();
+	} catch(std::exception& e) {
+		std::cout << "Error: " << e.what() << '\n';
+		++nFailures;
+	}
+	std::remove(filename);
+	std::remove(copyFilename);
+	
+	if(nFailures != 0)
+	{
+		std::cout << nFailures << " check(s) failed.\n";
+		return 1;
+	}
+	std::cout << "All checks passed.\n";
+	return 0;
+}
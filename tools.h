@@ -0,0 +1,35 @@
+#ifndef TOOLS_H
+#define TOOLS_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * The command-line tools as functions, so that apertoolsd can run them
+ * in-process as well as from their own executables. They take the same
+ * arguments as main(), write their messages to std::cout and throw an
+ * exception on errors.
+ * @returns The exit status.
+ */
+int RunApBeam(int argc, char* argv[]);
+int RunApplyBeam(int argc, char* argv[]);
+int RunApIndex(int argc, char* argv[]);
+
+/**
+ * Keep the beam generators of the last @p size image geometries that apbeam
+ * was run on, so that a later run on an image with the same geometry reuses
+ * the calculated distance map. Default: 0, which keeps nothing, as a single
+ * run gains nothing from it.
+ */
+void SetApBeamCacheSize(size_t size);
+
+/**
+ * Directory for the distance maps of apbeam runs that do not give
+ * -distance-cache themselves, so that separate processes (like the workers
+ * of apertoolsd) share the maps through the disk. The maps are stored in
+ * single precision, so the beams differ slightly from uncached runs.
+ * Default: empty, which stores no maps.
+ */
+void SetApBeamDefaultDistanceCache(const std::string& directory);
+
+#endif
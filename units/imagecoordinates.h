@@ -90,6 +90,32 @@ class ImageCoordinates
 			return cosVal <= 1.0 ? std::acos(cosVal) : 0.0;
 		}
 		
+		/**
+		 * Angular distance between the phase centre and the direction with the
+		 * given l,m coordinates. This is equal to calculating the ra,dec with
+		 * LMToRaDec() followed by AngularDistance() to the phase centre, because
+		 * cos(distance) = n = sqrt(1 - l^2 - m^2), but takes one asin instead of five
+		 * trigonometric functions and is accurate close to the phase centre.
+		 * Directions outside the unit circle (l^2 + m^2 > 1) give NaN.
+		 */
+		template<typename T>
+		static T LMToPhaseCentreDistance(T l, T m)
+		{
+			return std::asin(std::sqrt(l*l + m*m));
+		}
+		
+		/**
+		 * Same as LMToPhaseCentreDistance(l, m), for an image of which the centre is
+		 * shifted from the phase centre. The l,m coordinates are relative to the image
+		 * centre, as given by XYToLM(), and phaseCentreDL/DM are the shift of the image
+		 * centre (see FitsReader::PhaseCentreDL()).
+		 */
+		template<typename T>
+		static T LMToPhaseCentreDistance(T l, T m, T phaseCentreDL, T phaseCentreDM)
+		{
+			return LMToPhaseCentreDistance(l + phaseCentreDL, m + phaseCentreDM);
+		}
+		
 		template<typename T>
 		static T MeanRA(const std::vector<T>& raValues)
 		{
@@ -46,6 +46,41 @@ public:
 			destDec = acos((cosDec0 - m*sinDec0) / cosDeltaAlpha);
 	}
 
+	/**
+	 * Angular distance between the phase centre and the direction with the given l,m
+	 * coordinates. The sine and cosine of the phase centre declination are taken as
+	 * parameters, so that they can be calculated once per image.
+	 * 
+	 * With deltaRa = ra - ra0, cos dec cos deltaRa = cos dec0 - m sin dec0 and
+	 * cos dec sin deltaRa = l, so the difference between the unit vectors of the
+	 * direction and the phase centre follows without trigonometry. The distance
+	 * is calculated from the length of this chord, which stays accurate close to
+	 * the phase centre.
+	 */
+	template<typename T>
+	static T LMToPhaseCentreDistance(T l, T m, T sinPhaseCentreDec, T cosPhaseCentreDec)
+	{
+		const T
+			cosDecCosDeltaAlpha = cosPhaseCentreDec - m*sinPhaseCentreDec,
+			sinDecAbs = std::sqrt(T(1.0) - l*l - cosDecCosDeltaAlpha*cosDecCosDeltaAlpha),
+			sinDec = sinPhaseCentreDec < T(0.0) ? -sinDecAbs : sinDecAbs,
+			dx = m*sinPhaseCentreDec,
+			dz = sinDec - sinPhaseCentreDec,
+			chord = std::sqrt(dx*dx + l*l + dz*dz);
+		return T(2.0) * std::asin(chord * T(0.5));
+	}
+	
+	/**
+	 * Same as LMToPhaseCentreDistance(l, m, sinPhaseCentreDec, cosPhaseCentreDec), for an
+	 * image of which the centre is shifted by phaseCentreDL, phaseCentreDM from the phase
+	 * centre (see ImageCoordinates::LMToPhaseCentreDistance()).
+	 */
+	template<typename T>
+	static T LMToPhaseCentreDistance(T l, T m, T phaseCentreDL, T phaseCentreDM, T sinPhaseCentreDec, T cosPhaseCentreDec)
+	{
+		return LMToPhaseCentreDistance(l + phaseCentreDL, m + phaseCentreDM, sinPhaseCentreDec, cosPhaseCentreDec);
+	}
+
 	NCPProjection() = delete;
 };
 